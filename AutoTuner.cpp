@@ -0,0 +1,231 @@
+#ifndef AUTO_TUNER_CPP
+#define AUTO_TUNER_CPP
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+
+#include <unistd.h>
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+#include "AutoTuner.h"
+
+namespace {
+    /** The schedules (and chunk sizes) tried by the tuner. */
+    const std::pair<omp_sched_t, int> Schedules[] = {
+        {omp_sched_static, 0}, {omp_sched_dynamic, 1},
+        {omp_sched_dynamic, 4}, {omp_sched_guided, 1}
+    };
+
+    /** The strip widths tried by the tuner. */
+    const int StripWidths[] = {0, 8, 16};
+
+    /** Time the search of the sampled rows with a given configuration.
+
+        \return The elapsed time in seconds.
+    */
+    double timeSearch(const PNG& img, const SearchKernel& kernel,
+                      const std::vector<int>& rows, const int numCols,
+                      const TuneConfig& config) {
+        omp_set_num_threads(config.threads);
+        omp_set_schedule(config.schedule, config.chunkSize);
+        const double start = omp_get_wtime();
+#pragma omp parallel default(shared)
+        {
+            std::vector<unsigned char> hits(numCols);
+#pragma omp for schedule(runtime)
+            for (size_t i = 0; (i < rows.size()); i++) {
+                kernel.matchRow(img, rows[i], numCols, hits.data());
+            }
+        }
+        return omp_get_wtime() - start;
+    }
+}
+
+std::string
+TuneConfig::scheduleString() const {
+    const char* name = (schedule == omp_sched_static) ? "static" :
+        ((schedule == omp_sched_guided) ? "guided" : "dynamic");
+    return std::string(name) + "," + std::to_string(chunkSize);
+}
+
+void
+TuneConfig::setSchedule(const std::string& spec) {
+    const size_t comma = spec.find(',');
+    const std::string name = spec.substr(0, comma);
+    if (name == "static") {
+        schedule = omp_sched_static;
+    } else if (name == "dynamic") {
+        schedule = omp_sched_dynamic;
+    } else if (name == "guided") {
+        schedule = omp_sched_guided;
+    } else {
+        throw std::invalid_argument("Invalid schedule: " + spec);
+    }
+    // A chunk size of 0 implies the OpenMP default for the schedule.
+    chunkSize = (comma == std::string::npos) ?
+        ((schedule == omp_sched_static) ? 0 : 1) :
+        std::stoi(spec.substr(comma + 1));
+}
+
+TuneProfile::TuneProfile(const std::string& path) : path(path) {
+    std::ifstream is(path);
+    std::string line;
+    for (int lineNum = 1; std::getline(is, line); lineNum++) {
+        std::istringstream fields(line);
+        std::string key, schedule;
+        TuneConfig config;
+        if (!std::getline(fields, key, '\t') ||
+            !(fields >> config.threads >> schedule >> config.stripWidth)) {
+            continue;  // Not an entry (e.g., a blank line)
+        }
+        // A bad entry is skipped so that it does not break every search.
+        try {
+            config.setSchedule(schedule);
+            if ((config.threads < 1) || (config.chunkSize < 0) ||
+                ((config.stripWidth != 0) && (config.stripWidth != 8) &&
+                 (config.stripWidth != 16))) {
+                throw std::invalid_argument("Invalid configuration");
+            }
+            configs[key] = config;
+        } catch (const std::logic_error& exp) {
+            std::cerr << "Warning: skipping line " << lineNum << " of "
+                      << path << ": " << exp.what() << std::endl;
+        }
+    }
+}
+
+std::string
+TuneProfile::cpuModel() {
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.compare(0, 10, "model name") == 0) {
+            const size_t colon = line.find(':');
+            return line.substr(line.find_first_not_of(" \t", colon + 1));
+        }
+    }
+    return "unknown";
+}
+
+std::string
+TuneProfile::makeKey(const PNG& img, const PNG& mask) {
+    std::ostringstream key;
+    key << cpuModel() << " (" << sysconf(_SC_NPROCESSORS_ONLN)
+        << " cpus) " << img.getWidth() << "x" << img.getHeight() << " "
+        << mask.getWidth() << "x" << mask.getHeight();
+    return key.str();
+}
+
+std::string
+TuneProfile::defaultPath() {
+    const char* home = std::getenv("HOME");
+    return (home != NULL) ? (std::string(home) + "/.imagesearch.profile") :
+        ".imagesearch.profile";
+}
+
+bool
+TuneProfile::find(const std::string& key, TuneConfig& config) const {
+    const auto entry = configs.find(key);
+    if (entry == configs.end()) {
+        return false;
+    }
+    config = entry->second;
+    return true;
+}
+
+void
+TuneProfile::store(const std::string& key, const TuneConfig& config) {
+    configs[key] = config;
+    // Write to a temporary file and rename it into place.
+    const std::string tmpPath = path + ".tmp." + std::to_string(getpid());
+    std::ofstream os(tmpPath);
+    for (const auto& entry : configs) {
+        os << entry.first << '\t' << entry.second.threads << ' '
+           << entry.second.scheduleString() << ' '
+           << entry.second.stripWidth << '\n';
+    }
+    os.close();
+    if (!os || (rename(tmpPath.c_str(), path.c_str()) != 0)) {
+        unlink(tmpPath.c_str());
+        throw std::runtime_error("Error writing tuning profile " + path);
+    }
+}
+
+TuneConfig
+AutoTuner::calibrate(const PNG& img, const PNG& mask, bool isMask,
+                     ScoreMetric metric, int channels, int matchPercent,
+                     int tolerance, std::ostream& os) {
+    const int maxThreads = omp_get_max_threads();
+    const int numRows = img.getHeight() - mask.getHeight() + 1;
+    const int numCols = img.getWidth()  - mask.getWidth()  + 1;
+    TuneConfig best;
+    if ((numRows <= 0) || (numCols <= 0)) {
+        return best;  // Nothing to search
+    }
+    // Sample rows evenly spaced across the image, enough for a few
+    // rows per thread.
+    const int numSamples = std::min(numRows, std::max(8, 4 * maxThreads));
+    std::vector<int> rows;
+    for (int i = 0; (i < numSamples); i++) {
+        rows.push_back(int(int64_t(i) * numRows / numSamples));
+    }
+    double bestTime = 1e30;
+    for (const int stripWidth : StripWidths) {
+        const SearchKernel kernel(mask, isMask, metric, channels,
+                                  matchPercent, tolerance, stripWidth);
+        // An untimed run to warm up the caches and the threads.
+        timeSearch(img, kernel, rows, numCols, {maxThreads});
+        for (int threads = maxThreads; (threads >= 1); threads /= 2) {
+            for (const auto& schedule : Schedules) {
+                const TuneConfig config{threads, schedule.first,
+                                        schedule.second, stripWidth};
+                const double time = timeSearch(img, kernel, rows, numCols,
+                                               config);
+                std::ostringstream ms;
+                ms << std::fixed << std::setprecision(2) << time * 1000;
+                os << "Tuning: threads=" << threads << " schedule="
+                   << config.scheduleString() << " strip-width="
+                   << stripWidth << ": " << ms.str() << " ms\n";
+                if (time < bestTime) {
+                    best     = config;
+                    bestTime = time;
+                }
+                if (threads == 1) {
+                    break;  // The schedule does not matter
+                }
+            }
+        }
+    }
+    omp_set_num_threads(maxThreads);
+    os << "Tuned configuration: threads=" << best.threads << " schedule="
+       << best.scheduleString() << " strip-width=" << best.stripWidth
+       << std::endl;
+    return best;
+}
+
+#endif
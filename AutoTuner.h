@@ -0,0 +1,132 @@
+#ifndef AUTO_TUNER_H
+#define AUTO_TUNER_H
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+
+#include <omp.h>
+#include <map>
+#include <string>
+#include <iostream>
+#include "PNG.h"
+#include "SearchKernel.h"
+
+/**
+   The parallel layout of a search: the number of threads, how rows
+   are scheduled across the threads, and the number of adjacent
+   windows scored together by the kernels.
+*/
+struct TuneConfig {
+    /** The number of threads. Zero indicates the OpenMP default. */
+    int threads = 0;
+
+    /** The OpenMP schedule used to distribute rows to threads. */
+    omp_sched_t schedule = omp_sched_dynamic;
+
+    /** The chunk size (in rows) used by the schedule. */
+    int chunkSize = 1;
+
+    /** The strip width used by the kernels (0, 8, or 16). */
+    int stripWidth = 16;
+
+    /** Convert the schedule to a string such as "dynamic,4". */
+    std::string scheduleString() const;
+
+    /** Set the schedule from a string such as "dynamic,4".
+
+        \throws std::invalid_argument If the schedule is not valid.
+    */
+    void setSchedule(const std::string& spec);
+};
+
+/**
+   A persistent collection of tuned configurations. Configurations
+   are keyed by the CPU model and the dimensions of the image and the
+   mask. The profile is a text file with one tab-separated line per
+   key: the key, threads, schedule, and strip width.
+*/
+class TuneProfile {
+public:
+    /** Load the profile from the given file, if it exists. Entries
+        with an invalid schedule, thread count, or strip width are
+        skipped with a warning.
+    */
+    explicit TuneProfile(const std::string& path);
+
+    /** Create the key for a workload on this machine. */
+    static std::string makeKey(const PNG& img, const PNG& mask);
+
+    /** The model name of the CPU (from /proc/cpuinfo). */
+    static std::string cpuModel();
+
+    /** Find the configuration for the given key.
+
+        \return true if a configuration was found.
+    */
+    bool find(const std::string& key, TuneConfig& config) const;
+
+    /** Add (or replace) the configuration for the given key and save
+        the profile.
+
+        \throws std::runtime_error If the profile could not be saved.
+    */
+    void store(const std::string& key, const TuneConfig& config);
+
+    /** The default location of the profile: ~/.imagesearch.profile */
+    static std::string defaultPath();
+
+private:
+    /** The file from which the profile was loaded. */
+    std::string path;
+
+    /** The configuration for each key. */
+    std::map<std::string, TuneConfig> configs;
+};
+
+/**
+   Calibrates the parallel layout of a search by timing short searches
+   on a sample of rows of the image for each candidate configuration.
+*/
+class AutoTuner {
+public:
+    /** Find the fastest configuration for searching the given image.
+        The candidates are all combinations of thread counts (halving
+        from the maximum), schedules, and strip widths.
+
+        \param[in] img The image to be searched. All rows must be
+        available.
+
+        \param[in] mask The mask (or sub-image) to be searched for. The
+        remaining parameters are passed on to the SearchKernel (the
+        strip width is varied by the tuner).
+
+        \param[in] os The stream to which the timing of each candidate
+        is reported.
+
+        \return The fastest configuration.
+    */
+    static TuneConfig calibrate(const PNG& img, const PNG& mask,
+                                bool isMask, ScoreMetric metric,
+                                int channels, int matchPercent,
+                                int tolerance, std::ostream& os);
+};
+
+#endif
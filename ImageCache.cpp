@@ -0,0 +1,292 @@
+#ifndef IMAGE_CACHE_CPP
+#define IMAGE_CACHE_CPP
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include "ImageCache.h"
+
+namespace {
+    /** All sections in the sidecar start at a multiple of this value. */
+    constexpr uint64_t SectionAlignment = 4096;
+
+    /** The magic string at the start of every sidecar. */
+    constexpr char Magic[8] = "ISCACHE";
+
+    uint64_t alignUp(const uint64_t value) {
+        return (value + SectionAlignment - 1) / SectionAlignment *
+            SectionAlignment;
+    }
+
+    /** Helper to write bytes to the sidecar, checking for errors. */
+    void writeBytes(FILE* fp, const void* data, const size_t size) {
+        if ((size > 0) && (fwrite(data, 1, size, fp) != size)) {
+            throw std::runtime_error("Error writing image cache");
+        }
+    }
+}
+
+ImageCache::ImageCache(const std::string& imageFile,
+                       const std::string& cacheDir) : imageFile(imageFile) {
+    if (cacheDir.empty()) {
+        cachePath = imageFile + ".iscache";
+    } else {
+        // Use just the base name of the image in the cache directory.
+        const size_t slash = imageFile.rfind('/');
+        const std::string baseName = (slash == std::string::npos) ?
+            imageFile : imageFile.substr(slash + 1);
+        cachePath = cacheDir + "/" + baseName + ".iscache";
+    }
+}
+
+bool
+ImageCache::statSource(uint64_t& size, int64_t& mtime) const {
+    struct stat info;
+    if (stat(imageFile.c_str(), &info) != 0) {
+        return false;
+    }
+    size  = info.st_size;
+    mtime = int64_t(info.st_mtim.tv_sec) * 1000000000LL +
+        info.st_mtim.tv_nsec;
+    return true;
+}
+
+uint64_t
+ImageCache::hashFile(const std::string& fileName) {
+    FILE* fp = fopen(fileName.c_str(), "rb");
+    if (fp == NULL) {
+        throw std::runtime_error("File (" + fileName + ") could not be "
+                                 "opened for hashing");
+    }
+    // A simple multiply-xorshift hash over 8-byte words. This is fast
+    // and sufficient to detect changed content (not tampering).
+    constexpr uint64_t Prime = 0x9E3779B97F4A7C15ULL;
+    std::vector<unsigned char> buf(1 << 20);
+    uint64_t hash = 0xCBF29CE484222325ULL, total = 0;
+    size_t count;
+    while ((count = fread(buf.data(), 1, buf.size(), fp)) > 0) {
+        size_t i = 0;
+        for (; (i + 8 <= count); i += 8) {
+            uint64_t word;
+            std::memcpy(&word, &buf[i], sizeof(word));
+            hash = (hash ^ word) * Prime;
+            hash ^= (hash >> 32);
+        }
+        for (; (i < count); i++) {
+            hash = (hash ^ buf[i]) * Prime;
+        }
+        total += count;
+    }
+    fclose(fp);
+    return (hash ^ total) * Prime;
+}
+
+bool
+ImageCache::load(PNG& img) {
+    uint64_t srcSize;
+    int64_t  srcMtime;
+    modified = true;  // Until a valid sidecar is mapped
+    if (!statSource(srcSize, srcMtime) || (access(cachePath.c_str(), R_OK))) {
+        return false;  // No source or no sidecar
+    }
+    std::shared_ptr<MappedFile> file;
+    try {
+        file = std::make_shared<MappedFile>(cachePath);
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+    // Validate the header.
+    Header hdr;
+    if (file->size() < sizeof(hdr)) {
+        return false;
+    }
+    std::memcpy(&hdr, file->data(), sizeof(hdr));
+    if ((std::memcmp(hdr.magic, Magic, sizeof(Magic)) != 0) ||
+        (hdr.version != Version) || (hdr.srcSize != srcSize) ||
+        (sizeof(hdr) + uint64_t(hdr.numSections) * sizeof(Section) >
+         file->size())) {
+        return false;
+    }
+    if (hdr.srcMtime != srcMtime) {
+        // The source has been touched. Check if it really changed.
+        if (!hashed) {
+            srcHash = hashFile(imageFile);
+            hashed  = true;
+        }
+        if (srcHash != hdr.srcHash) {
+            return false;
+        }
+        // The content is unchanged. Record the new modification time so
+        // that subsequent runs do not hash the source again. Failing to
+        // update the header (say, a read-only cache) is not an error.
+        hdr.srcMtime = srcMtime;
+        FILE* fp = fopen(cachePath.c_str(), "r+b");
+        if (fp != NULL) {
+            fwrite(&hdr, sizeof(hdr), 1, fp);
+            fclose(fp);
+        }
+    }
+    srcHash = hdr.srcHash;
+    hashed  = true;
+    // Load and validate the section table.
+    std::vector<Section> table(hdr.numSections);
+    std::memcpy(table.data(), file->data() + sizeof(hdr),
+                table.size() * sizeof(Section));
+    const Section* pixels = NULL;
+    for (const Section& sec : table) {
+        if (sec.offset + sec.size > file->size()) {
+            return false;  // truncated sidecar
+        }
+        if (sec.tag == PixelsTag) {
+            pixels = &sec;
+        }
+    }
+    if ((pixels == NULL) ||
+        (pixels->size != uint64_t(hdr.width) * hdr.height * 4)) {
+        return false;
+    }
+    // Everything checks out. Use the mapped pixels directly.
+    img.attach(file, pixels->offset, hdr.width, hdr.height);
+    mapped   = file;
+    sections = table;
+    modified = false;
+    return true;
+}
+
+const unsigned char*
+ImageCache::getSection(uint32_t tag, size_t& size) const {
+    const auto entry = pending.find(tag);
+    if (entry != pending.end()) {
+        size = entry->second.size();
+        return entry->second.data();
+    }
+    for (const Section& sec : sections) {
+        if (sec.tag == tag) {
+            size = sec.size;
+            return mapped->data() + sec.offset;
+        }
+    }
+    size = 0;
+    return NULL;
+}
+
+bool
+ImageCache::getImage(uint32_t tag, int width, int height, PNG& img) const {
+    const size_t expected = size_t(width) * height * 4;
+    if (pending.count(tag) == 0) {
+        // Refer directly to the mapped section, if present.
+        for (const Section& sec : sections) {
+            if ((sec.tag == tag) && (sec.size == expected)) {
+                img.attach(mapped, sec.offset, width, height);
+                return true;
+            }
+        }
+        return false;
+    }
+    size_t size = 0;
+    const unsigned char* data = getSection(tag, size);
+    if (size != expected) {
+        return false;
+    }
+    img.create(width, height);
+    std::copy(data, data + size, img.getPixels());
+    return true;
+}
+
+void
+ImageCache::addSection(uint32_t tag, std::vector<unsigned char> data) {
+    pending[tag] = std::move(data);
+    modified     = true;
+}
+
+void
+ImageCache::save(const PNG& img) {
+    Header hdr;
+    std::memcpy(hdr.magic, Magic, sizeof(Magic));
+    hdr.version = Version;
+    if (!statSource(hdr.srcSize, hdr.srcMtime)) {
+        throw std::runtime_error("Unable to stat " + imageFile);
+    }
+    if (!hashed) {
+        srcHash = hashFile(imageFile);
+        hashed  = true;
+    }
+    hdr.srcHash = srcHash;
+    hdr.width   = img.getWidth();
+    hdr.height  = img.getHeight();
+
+    // Gather the sections to be written: the pixels, sections from a
+    // previously mapped sidecar, and newly added sections.
+    std::vector<std::pair<Section, const unsigned char*>> toWrite;
+    toWrite.push_back({{PixelsTag, 0, 0, uint64_t(img.getBufferSize())},
+                       img.getPixels()});
+    for (const Section& sec : sections) {
+        if ((sec.tag != PixelsTag) && (pending.count(sec.tag) == 0)) {
+            toWrite.push_back({sec, mapped->data() + sec.offset});
+        }
+    }
+    for (const auto& entry : pending) {
+        toWrite.push_back({{entry.first, 0, 0, entry.second.size()},
+                           entry.second.data()});
+    }
+    // Lay out the sections at page-aligned offsets.
+    hdr.numSections = toWrite.size();
+    uint64_t offset = alignUp(sizeof(hdr) + toWrite.size() * sizeof(Section));
+    for (auto& entry : toWrite) {
+        entry.first.offset = offset;
+        offset = alignUp(offset + entry.first.size);
+    }
+
+    // Write to a temporary file and rename it into place.
+    const std::string tmpPath = cachePath + ".tmp." + std::to_string(getpid());
+    FILE* fp = fopen(tmpPath.c_str(), "wb");
+    if (fp == NULL) {
+        throw std::runtime_error("Image cache (" + tmpPath + ") could not "
+                                 "be opened for writing");
+    }
+    try {
+        writeBytes(fp, &hdr, sizeof(hdr));
+        for (const auto& entry : toWrite) {
+            writeBytes(fp, &entry.first, sizeof(Section));
+        }
+        const std::vector<char> zeros(SectionAlignment, 0);
+        for (const auto& entry : toWrite) {
+            writeBytes(fp, zeros.data(), entry.first.offset - ftell(fp));
+            writeBytes(fp, entry.second, entry.first.size);
+        }
+    } catch (const std::runtime_error&) {
+        fclose(fp);
+        unlink(tmpPath.c_str());
+        throw;
+    }
+    if ((fclose(fp) != 0) || (rename(tmpPath.c_str(), cachePath.c_str()))) {
+        unlink(tmpPath.c_str());
+        throw std::runtime_error("Error writing image cache " + cachePath);
+    }
+    modified = false;
+}
+
+#endif
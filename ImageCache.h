@@ -0,0 +1,213 @@
+#ifndef IMAGE_CACHE_H
+#define IMAGE_CACHE_H
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include "PNG.h"
+#include "MappedFile.h"
+
+/**
+   An on-disk "sidecar" cache of a decoded image and data derived
+   from it.
+
+   Decoding (inflating) a large PNG is expensive.  The sidecar file
+   stores the decoded RGBA pixels along with any number of derived
+   data sections (such as summed-area tables or pyramid levels), each
+   identified by a 4-character tag. Every section starts on a page
+   boundary so that the sidecar can be memory-mapped and used
+   directly, without copying.
+
+   A sidecar is valid only for the exact source file it was created
+   from. The size and modification time of the source are checked
+   first. If they differ, the content hash of the source is computed
+   and compared to the one stored in the sidecar.  The sidecar uses
+   the native byte order and is not meant to be shared across
+   architectures.
+*/
+class ImageCache {
+public:
+    /** The tag used for the section containing the decoded pixels. */
+    static constexpr uint32_t PixelsTag = 0x4c584950;  // "PIXL"
+
+    /** Create a cache for the given image file.
+
+        \param[in] imageFile The path to the source PNG image.
+
+        \param[in] cacheDir The directory in which the sidecar is to be
+        stored. If this string is empty then the sidecar is stored
+        alongside the source image.
+    */
+    ImageCache(const std::string& imageFile, const std::string& cacheDir = "");
+
+    /** Try to load the image from a valid sidecar.
+
+        \param[out] img The image to be attached to the mapped pixels
+        on success. This image is not modified on failure.
+
+        \return This method returns true if a valid sidecar was found
+        and mapped. Otherwise this method returns false.
+    */
+    bool load(PNG& img);
+
+    /** Obtain a derived data section from a mapped sidecar.
+
+        \param[in] tag The 4-character tag identifying the section.
+
+        \param[out] size The size of the section in bytes.
+
+        \return A pointer to the (mapped) data of the section or NULL
+        if the section is not present.
+    */
+    const unsigned char* getSection(uint32_t tag, size_t& size) const;
+
+    /** Add a derived data section to be written by the next call to
+        save(). Sections already present in a mapped sidecar are
+        retained, unless replaced by this method. The section is
+        immediately available via getSection().
+
+        \param[in] tag The 4-character tag identifying the section.
+
+        \param[in] data The bytes of the section.
+    */
+    void addSection(uint32_t tag, std::vector<unsigned char> data);
+
+    /** Obtain a derived image (such as a pyramid level) stored in a
+        section.  Images in a mapped sidecar are not copied.
+
+        \param[in] tag The 4-character tag identifying the section.
+
+        \param[in] width The expected width of the image.
+
+        \param[in] height The expected height of the image.
+
+        \param[out] img The image to be set to the pixels in the
+        section.
+
+        \return true if the section exists and has the expected size.
+    */
+    bool getImage(uint32_t tag, int width, int height, PNG& img) const;
+
+    /** Convenience method to add a derived image as a section.
+
+        \param[in] tag The 4-character tag identifying the section.
+
+        \param[in] img The image whose pixels are to be stored.
+    */
+    void addImage(uint32_t tag, const PNG& img) {
+        addSection(tag, std::vector<unsigned char>(img.getPixels(),
+                        img.getPixels() + img.getBufferSize()));
+    }
+
+    /** Determine if the sidecar needs to be written, that is, if
+        load() did not find a valid sidecar or if addSection() has been
+        called since the sidecar was last loaded or saved.
+    */
+    bool isModified() const { return modified; }
+
+    /** Write the sidecar for the given decoded image along with all
+        the derived data sections.  The file is written to a temporary
+        file and renamed so that concurrent runs never observe a
+        partial sidecar.
+
+        \param[in] img The image (decoded from the source file). The
+        image must not have been modified after loading it.
+
+        \throws std::runtime_error On errors writing the sidecar.
+    */
+    void save(const PNG& img);
+
+    /** The path to the sidecar file used by this cache. */
+    const std::string& getPath() const { return cachePath; }
+
+    /** Compute a fast (non-cryptographic) 64-bit content hash of the
+        given file.
+
+        \param[in] fileName The path to the file to be hashed.
+
+        \return The hash of the bytes in the file.
+    */
+    static uint64_t hashFile(const std::string& fileName);
+
+protected:
+    /** The fixed-size header at the start of every sidecar file. */
+    struct Header {
+        char     magic[8];      // "ISCACHE" plus a NUL terminator.
+        uint32_t version;       // Format version (Version below).
+        uint32_t numSections;   // Entries in the section table.
+        uint64_t srcSize;       // Size of the source PNG file.
+        int64_t  srcMtime;      // Modification time (ns) of source.
+        uint64_t srcHash;       // Content hash of the source file.
+        int32_t  width;         // Width of the decoded image.
+        int32_t  height;        // Height of the decoded image.
+    };
+
+    /** An entry in the section table that follows the header. */
+    struct Section {
+        uint32_t tag;           // 4-character tag of the section.
+        uint32_t reserved;      // Padding, always zero.
+        uint64_t offset;        // Page-aligned offset in the file.
+        uint64_t size;          // Size of the section in bytes.
+    };
+
+    /** The current version of the sidecar format. */
+    static constexpr uint32_t Version = 1;
+
+    /** Helper method to obtain the size and modification time (in
+        nanoseconds) of the source image.
+
+        \return false if the source file could not be stat'ed.
+    */
+    bool statSource(uint64_t& size, int64_t& mtime) const;
+
+private:
+    /** The path to the source PNG image. */
+    std::string imageFile;
+
+    /** The path to the sidecar file. */
+    std::string cachePath;
+
+    /** The mapped sidecar, if load() succeeded. */
+    std::shared_ptr<MappedFile> mapped;
+
+    /** The section table of the mapped sidecar. */
+    std::vector<Section> sections;
+
+    /** Sections added via addSection() that override mapped ones. */
+    std::unordered_map<uint32_t, std::vector<unsigned char>> pending;
+
+    /** Flag to indicate the sidecar is missing or invalid, or that
+        sections have been added since load/save.
+    */
+    bool modified = false;
+
+    /** Flag to indicate if srcHash has been computed. */
+    bool hashed = false;
+
+    /** The content hash of the source, if it has been computed. */
+    uint64_t srcHash = 0;
+};
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef IMAGE_PYRAMID_CPP
+#define IMAGE_PYRAMID_CPP
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <cmath>
+#include <algorithm>
+#include "ImagePyramid.h"
+
+namespace {
+    /** The tag of the cache section holding a given level ("PYR1" etc.) */
+    uint32_t levelTag(const int level) {
+        return 'P' | ('Y' << 8) | ('R' << 16) | (uint32_t('0' + level) << 24);
+    }
+}
+
+ImagePyramid::ImagePyramid(const PNG& base, ImageCache* cache) :
+    base(base), cache(cache) {
+}
+
+void
+ImagePyramid::build(int maxLevel) {
+    for (int level = levels.size() + 1; (level <= maxLevel); level++) {
+        const PNG& prev = getLevel(level - 1);
+        const int width = prev.getWidth() / 2, height = prev.getHeight() / 2;
+        PNG img;
+        if ((cache == NULL) ||
+            !cache->getImage(levelTag(level), width, height, img)) {
+            img = downsample(prev);
+            if (cache != NULL) {
+                cache->addImage(levelTag(level), img);
+            }
+        }
+        levels.push_back(std::move(img));
+    }
+}
+
+PNG
+ImagePyramid::downsample(const PNG& src) {
+    PNG dst;
+    dst.create(src.getWidth() / 2, src.getHeight() / 2);
+    const size_t srcStride = size_t(src.getWidth()) * 4;
+    const unsigned char* const srcPix = src.getPixels();
+    unsigned char* const dstPix = dst.getPixels();
+#pragma omp parallel for
+    for (int row = 0; row < dst.getHeight(); row++) {
+        const unsigned char* top = srcPix + (2 * row) * srcStride;
+        const unsigned char* bot = top + srcStride;
+        unsigned char* out = dstPix + size_t(row) * dst.getWidth() * 4;
+        for (int i = 0; (i < dst.getWidth() * 4); i++) {
+            // Index of the same channel in the left pixel of the block
+            const int j = (i / 4) * 8 + (i % 4);
+            out[i] = (top[j] + top[j + 4] + bot[j] + bot[j + 4] + 2) / 4;
+        }
+    }
+    return dst;
+}
+
+PNG
+ImagePyramid::resample(const PNG& src, double scale, bool nearest) {
+    const int width  = std::max(1, int(std::lround(src.getWidth()  * scale)));
+    const int height = std::max(1, int(std::lround(src.getHeight() * scale)));
+    const double rowScale = double(src.getHeight()) / height;
+    const double colScale = double(src.getWidth())  / width;
+    PNG dst;
+    dst.create(width, height);
+    unsigned char* out = dst.getPixels();
+    for (int row = 0; (row < height); row++) {
+        // The location of the center of the destination pixel in src.
+        const double srcRow = (row + 0.5) * rowScale - 0.5;
+        for (int col = 0; (col < width); col++, out += 4) {
+            const double srcCol = (col + 0.5) * colScale - 0.5;
+            if (nearest) {
+                const int r = std::min(src.getHeight() - 1,
+                                       std::max(0, int(std::lround(srcRow))));
+                const int c = std::min(src.getWidth() - 1,
+                                       std::max(0, int(std::lround(srcCol))));
+                const Pixel pix = src.getPixel(r, c);
+                std::copy_n(&pix.color.red, 4, out);
+                continue;
+            }
+            // Bilinear interpolation of the 4 surrounding pixels.
+            const int r0 = std::max(0, int(std::floor(srcRow)));
+            const int c0 = std::max(0, int(std::floor(srcCol)));
+            const int r1 = std::min(src.getHeight() - 1, r0 + 1);
+            const int c1 = std::min(src.getWidth()  - 1, c0 + 1);
+            const double fr = std::min(1.0, std::max(0.0, srcRow - r0));
+            const double fc = std::min(1.0, std::max(0.0, srcCol - c0));
+            const Pixel p00 = src.getPixel(r0, c0), p01 = src.getPixel(r0, c1);
+            const Pixel p10 = src.getPixel(r1, c0), p11 = src.getPixel(r1, c1);
+            const unsigned char* q00 = &p00.color.red;
+            const unsigned char* q01 = &p01.color.red;
+            const unsigned char* q10 = &p10.color.red;
+            const unsigned char* q11 = &p11.color.red;
+            for (int c = 0; (c < 4); c++) {
+                const double top = q00[c] * (1 - fc) + q01[c] * fc;
+                const double bot = q10[c] * (1 - fc) + q11[c] * fc;
+                out[c] = std::lround(top * (1 - fr) + bot * fr);
+            }
+        }
+    }
+    return dst;
+}
+
+#endif
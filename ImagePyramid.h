@@ -0,0 +1,101 @@
+#ifndef IMAGE_PYRAMID_H
+#define IMAGE_PYRAMID_H
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <vector>
+#include "PNG.h"
+#include "ImageCache.h"
+
+/**
+   An image pyramid in which each level is half the width and height
+   of the previous level. Level 0 is the image itself (which is not
+   copied).  Levels are computed with a 2x2 box filter and, if an
+   ImageCache is supplied, they are loaded from (and added to) the
+   sidecar of the image.
+*/
+class ImagePyramid {
+public:
+    /** Create a pyramid for the given image.
+
+        \param[in] base The image at level 0. This image must remain
+        valid (and unmodified) while the pyramid is in use.
+
+        \param[in,out] cache An optional cache from which levels are
+        loaded and to which newly computed levels are added.
+    */
+    explicit ImagePyramid(const PNG& base, ImageCache* cache = NULL);
+
+    /** Ensure that all levels up to the given level are available.
+        This method must be called before the levels are used from
+        multiple threads.
+
+        \param[in] maxLevel The highest level needed.
+    */
+    void build(int maxLevel);
+
+    /** Obtain a level of the pyramid that has already been built.
+
+        \param[in] level The level (0 is the base image).
+
+        \return The image at the given level.
+    */
+    const PNG& getLevel(const int level) const {
+        return (level == 0) ? base : levels.at(level - 1);
+    }
+
+    /** Compute an image that is half the width and height of the
+        given image by averaging 2x2 blocks of pixels.
+
+        \param[in] src The image to be down-sampled.
+
+        \return The down-sampled image.
+    */
+    static PNG downsample(const PNG& src);
+
+    /** Resample an image by the given scale factor.
+
+        \param[in] src The image to be resampled.
+
+        \param[in] scale The scale factor. The size of the resulting
+        image is the size of src multiplied by scale (rounded to the
+        nearest pixel, but at least 1 pixel).
+
+        \param[in] nearest If true nearest-neighbor sampling is used,
+        which preserves the exact colors of black-and-white masks.
+        Otherwise bilinear interpolation is used.
+
+        \return The resampled image.
+    */
+    static PNG resample(const PNG& src, double scale, bool nearest);
+
+private:
+    /** The image at level 0 of the pyramid. */
+    const PNG& base;
+
+    /** Optional cache for the levels of the pyramid. */
+    ImageCache* cache;
+
+    /** The levels 1, 2, ... of the pyramid. */
+    std::vector<PNG> levels;
+};
+
+#endif
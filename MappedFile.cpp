@@ -0,0 +1,67 @@
+#ifndef MAPPED_FILE_CPP
+#define MAPPED_FILE_CPP
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdexcept>
+#include "MappedFile.h"
+
+MappedFile::MappedFile(const std::string& path) : path(path), bytes(NULL),
+                                                  length(0) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw std::runtime_error("File (" + path + ") could not be opened "
+                                 "for mapping");
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("Unable to stat file " + path);
+    }
+    length = info.st_size;
+    if (length > 0) {
+        // A private mapping makes writes copy-on-write.
+        void* addr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                          fd, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Unable to memory-map file " + path);
+        }
+        bytes = static_cast<unsigned char*>(addr);
+        // Start read-ahead asynchronously so that the first accesses
+        // are less likely to block on disk.
+        madvise(addr, length, MADV_WILLNEED);
+    }
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (bytes != NULL) {
+        munmap(bytes, length);
+    }
+}
+
+#endif
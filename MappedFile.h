@@ -0,0 +1,72 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <string>
+#include <cstddef>
+
+/**
+   A simple RAII wrapper around a memory-mapped file.
+
+   The file is mapped privately (copy-on-write). Hence, the mapped
+   bytes can be modified (for example, to draw boxes on an image that
+   is backed by the mapping) without changing the file on disk.
+*/
+class MappedFile {
+public:
+    /** Map the given file into memory.
+
+        \param[in] path The path to the file to be mapped.
+
+        \throws std::runtime_error If the file cannot be opened or
+        mapped.
+    */
+    explicit MappedFile(const std::string& path);
+
+    /** The destructor unmaps the file. */
+    ~MappedFile();
+
+    // A mapping is owned by exactly one object.
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /** Obtain a pointer to the first byte of the mapping. */
+    unsigned char* data() const { return bytes; }
+
+    /** The size of the mapped file in bytes. */
+    size_t size() const { return length; }
+
+    /** The path of the file that was mapped. */
+    const std::string& getPath() const { return path; }
+
+private:
+    /** The path to the file that has been mapped. */
+    std::string path;
+
+    /** The start of the mapping (NULL for empty files). */
+    unsigned char* bytes;
+
+    /** The number of bytes mapped. */
+    size_t length;
+};
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef MATCH_STREAM_H
+#define MATCH_STREAM_H
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <limits>
+#include <iostream>
+#include <algorithm>
+#include "MatchedRect.h"
+
+/**
+   A thread-safe class that collects the matches confirmed by the
+   search and decides which of them are reported.
+
+   Matches can be reported in one of three ways:
+
+   - Batch (the default): matches are reported, sorted, by finish().
+
+   - Streaming: each match is printed as soon as it is confirmed.
+
+   - Ordered streaming: matches are printed in row-major order, as
+     soon as all the rows before them have been searched.
+
+   In all modes, at most maxMatches are reported. Once that many have
+   been reported, isDone() returns true and the search can stop.
+*/
+class MatchStream {
+public:
+    /** How the matches are to be reported. */
+    enum Mode { Batch, Stream, Ordered };
+
+    /** Create a match stream.
+
+        \param[in] os The stream to which matches are printed.
+
+        \param[in] numRows The number of rows of windows being searched.
+
+        \param[in] mode The way matches are to be reported.
+
+        \param[in] maxMatches The maximum number of matches to report.
+        Zero indicates no limit.
+    */
+    MatchStream(std::ostream& os, const int numRows, const Mode mode,
+                const size_t maxMatches = 0) :
+        os(os), mode(mode), rowComplete(std::max(numRows, 0), false),
+        maxMatches(maxMatches ? maxMatches :
+                   std::numeric_limits<size_t>::max()) {}
+
+    /** Record a match confirmed by the search. */
+    void add(const MatchedRect& rect) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (mode == Ordered) {
+            pending.push_back(rect);
+        } else {
+            report(rect);
+        }
+    }
+
+    /** Record that all the windows starting in the given row have been
+        searched.
+    */
+    void rowDone(const int row) {
+        rowsDone++;
+        if (mode != Ordered) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        rowComplete[row] = true;
+        const int oldWatermark = watermark;
+        while ((watermark < int(rowComplete.size())) &&
+               rowComplete[watermark]) {
+            watermark++;
+        }
+        if (watermark > oldWatermark) {
+            // Report the pending matches in rows before the watermark.
+            reportPending(watermark);
+        }
+    }
+
+    /** Determine if the maximum number of matches have been reported. */
+    bool isDone() const { return done.load(std::memory_order_relaxed); }
+
+    /** The number of rows that have been completely searched. */
+    int getRowsDone() const { return rowsDone; }
+
+    /** Determine if matches are printed as they are found. */
+    bool isStreaming() const { return mode != Batch; }
+
+    /** Report any remaining matches and return the list of all the
+        reported matches. In batch mode the list is sorted. This method
+        must be called after the search is complete.
+    */
+    MatchedRectList finish() {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Report matches in rows that were not completely searched.
+        reportPending(std::numeric_limits<int>::max());
+        if (mode == Batch) {
+            std::sort(reported.begin(), reported.end());
+        }
+        return reported;
+    }
+
+protected:
+    /** Report a match (caller must hold the mutex). */
+    void report(const MatchedRect& rect) {
+        if (reported.size() >= maxMatches) {
+            return;  // Already have all the matches needed.
+        }
+        reported.push_back(rect);
+        if (mode != Batch) {
+            os << rect << std::endl;
+        }
+        if (reported.size() == maxMatches) {
+            done = true;
+        }
+    }
+
+    /** Report the pending matches in rows before endRow in row-major
+        order (caller must hold the mutex).
+    */
+    void reportPending(const int endRow) {
+        std::sort(pending.begin(), pending.end());
+        auto end = pending.begin();
+        for (; (end != pending.end()) && (end->row1 < endRow); end++) {
+            report(*end);
+        }
+        pending.erase(pending.begin(), end);
+    }
+
+private:
+    /** The stream to which matches are printed. */
+    std::ostream& os;
+
+    /** The way matches are to be reported. */
+    const Mode mode;
+
+    /** Mutex to serialize access to the lists of matches. */
+    std::mutex mutex;
+
+    /** Flags to indicate the rows that have been searched. */
+    std::vector<bool> rowComplete;
+
+    /** All rows before this row have been searched. */
+    int watermark = 0;
+
+    /** The number of rows that have been searched. */
+    std::atomic<int> rowsDone{0};
+
+    /** Matches found but not yet reported (in ordered mode). */
+    MatchedRectList pending;
+
+    /** The matches that have been reported. */
+    MatchedRectList reported;
+
+    /** The maximum number of matches to be reported. */
+    const size_t maxMatches;
+
+    /** Flag set once maxMatches have been reported. */
+    std::atomic<bool> done{false};
+};
+
+#endif
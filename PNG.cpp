@@ -24,15 +24,45 @@
 #include "PNG.h"
 #include "Assert.h"
 #include <string>
+#include <limits>
+#include <algorithm>
+
+namespace {
+    /** Check that the size of an image can be handled. Offsets of pixels
+        are computed in size_t, but the number of bytes in a row (the
+        stride) is an int.
+    */
+    void checkSize(const int width, const int height) {
+        if ((width < 0) || (height < 0) ||
+            (width > std::numeric_limits<int>::max() / 4)) {
+            throw std::runtime_error("Invalid image size: " +
+                                     std::to_string(width) + " x " +
+                                     std::to_string(height));
+        }
+    }
+}
 
 PNG::PNG() {
     width  = 0;
     height = 0;
+    pixels = NULL;
 }
 
-PNG::PNG(const PNG& src) : width(src.width), height(src.height) {
-    prepareBuffer();
-    flatImageBuffer = src.flatImageBuffer;
+PNG::PNG(const PNG& src) : width(src.width), height(src.height),
+    flatImageBuffer(src.pixels, src.pixels + src.getBufferSize()) {
+    // Copies always own their pixels, even if src is a mapped image.
+    setRowPointers();
+}
+
+PNG::PNG(PNG&& src) noexcept : width(src.width), height(src.height),
+    flatImageBuffer(std::move(src.flatImageBuffer)),
+    rowPointers(std::move(src.rowPointers)), pixels(src.pixels),
+    mappedFile(std::move(src.mappedFile)) {
+    // The row pointers remain valid as the buffer itself was moved.
+    src.width = src.height = 0;
+    src.flatImageBuffer.clear();
+    src.rowPointers.clear();
+    src.pixels = NULL;
 }
 
 PNG::~PNG() {
@@ -40,10 +70,30 @@ PNG::~PNG() {
 
 PNG&
 PNG::operator=(const PNG& src) {
-    this->width  = src.width;
-    this->height = src.height;
-    prepareBuffer();
-    flatImageBuffer = src.flatImageBuffer;
+    if (this != &src) {
+        this->width  = src.width;
+        this->height = src.height;
+        flatImageBuffer.assign(src.pixels, src.pixels + src.getBufferSize());
+        mappedFile.reset();
+        setRowPointers();
+    }
+    return *this;
+}
+
+PNG&
+PNG::operator=(PNG&& src) noexcept {
+    if (this != &src) {
+        width           = src.width;
+        height          = src.height;
+        flatImageBuffer = std::move(src.flatImageBuffer);
+        rowPointers     = std::move(src.rowPointers);
+        pixels          = src.pixels;
+        mappedFile      = std::move(src.mappedFile);
+        src.width = src.height = 0;
+        src.flatImageBuffer.clear();
+        src.rowPointers.clear();
+        src.pixels = NULL;
+    }
     return *this;
 }
 
@@ -72,7 +122,7 @@ PNG::validateHeader(const char* fileName) {
 }
 
 void
-PNG::open(const char* fileName) {
+PNG::open(const char* fileName, RowProgress* progress) {
     ASSERT(pngInfo == NULL);
     // Try to open the file and validate the PNG header in it.
     FILE *pngFile = validateHeader(fileName);
@@ -98,7 +148,7 @@ PNG::open(const char* fileName) {
         throw std::runtime_error("Specified PNG does not have bit depth of 8");
     }
     // Use helper method to load the actual image data
-    load(libpngHandle, pngInfo);
+    load(libpngHandle, pngInfo, progress);
     // Close the PNG file
     fclose(pngFile);
     png_destroy_read_struct(&libpngHandle, &pngInfo, NULL);
@@ -110,7 +160,12 @@ PNG::load(const std::string& fileName) {
 }
 
 void
-PNG::load(png_structp libpngHandle, png_infop pngInfo) {
+PNG::load(const std::string& fileName, RowProgress& progress) {
+    open(fileName.c_str(), &progress);
+}
+
+void
+PNG::load(png_structp libpngHandle, png_infop pngInfo, RowProgress* progress) {
     // Okay... This is where things get weird. Since libpng is a C
     // library, it can't use exceptions. Instead, it uses the
     // longjmp() mechanism. Here, we have the error catching code to
@@ -128,16 +183,51 @@ PNG::load(png_structp libpngHandle, png_infop pngInfo) {
     height = png_get_image_height(libpngHandle, pngInfo);
     // Prepare the in-memory buffer to load image
     prepareBuffer();
-    // Read the data into our internal buffers.
-    png_read_image(libpngHandle, &rowPointers[0]);
+    if (progress == NULL) {
+        // Read the data into our internal buffers.
+        png_read_image(libpngHandle, &rowPointers[0]);
+        return;
+    }
+    progress->setSize(width, height);
+    if (png_get_interlace_type(libpngHandle, pngInfo) != PNG_INTERLACE_NONE) {
+        // Rows of interlaced images are complete only after all passes
+        png_read_image(libpngHandle, &rowPointers[0]);
+    } else {
+        // Decode row-by-row, publishing rows as they become available.
+        for (int row = 0; (row < height); row++) {
+            png_read_row(libpngHandle, rowPointers[row], NULL);
+            progress->publish(row + 1);
+        }
+    }
+    progress->publish(height);
+}
+
+void
+PNG::attach(const std::shared_ptr<MappedFile>& file, size_t offset,
+            int width, int height) {
+    checkSize(width, height);
+    const size_t imgSize = size_t(width) * height * 4;
+    if ((file == nullptr) || (offset + imgSize > file->size())) {
+        throw std::runtime_error("Mapped file is too small for the image");
+    }
+    this->width  = width;
+    this->height = height;
+    flatImageBuffer.clear();
+    flatImageBuffer.shrink_to_fit();
+    mappedFile = file;
+    pixels     = file->data() + offset;
+    setRowPointers();
 }
 
 void
 PNG::create(int width, int height) {
+    checkSize(width, height);
     this->width  = width;
     this->height = height;
-    // Finally, prepare a buffer
-    prepareBuffer();    
+    // Finally, prepare a buffer. The buffer is not zero-filled by
+    // prepareBuffer, but a newly created image is expected to be blank.
+    prepareBuffer();
+    std::fill(flatImageBuffer.begin(), flatImageBuffer.end(), 0);
 }
 
 png_structp
@@ -202,18 +292,28 @@ PNG::write(const std::string& fileName) {
     fclose(pngFile);
 }
 
-int
+size_t
 PNG::getBufferSize() const {
-    return height * width * 4;
+    return size_t(width) * height * 4;
 }
 
 void
 PNG::prepareBuffer() {
+    // With PixelAllocator the resize does not initialize the bytes.
     flatImageBuffer.clear();
     flatImageBuffer.resize(getBufferSize());
+    mappedFile.reset();
+    setRowPointers();
+}
+
+void
+PNG::setRowPointers() {
+    if (mappedFile == nullptr) {
+        pixels = flatImageBuffer.data();
+    }
     rowPointers.resize(height);
-    unsigned char* const bufStart = &flatImageBuffer[0];
-    const int rowBytes            = width * 4;
+    unsigned char* const bufStart = pixels;
+    const size_t rowBytes         = size_t(width) * 4;
     for (int row = 0; (row < height); row++) {
         rowPointers[row] = bufStart + (row * rowBytes);
     }
@@ -221,9 +321,9 @@ PNG::prepareBuffer() {
 
 void
 PNG::setRed(const int row, const int col) {
-    const int idx = (row * width + col) * 4;
-    flatImageBuffer[idx + 1] = flatImageBuffer[idx + 2] = 0;
-    flatImageBuffer[idx]     = flatImageBuffer[idx + 3] = 255;        
+    const size_t idx = (size_t(row) * width + col) * 4;
+    pixels[idx + 1] = pixels[idx + 2] = 0;
+    pixels[idx]     = pixels[idx + 3] = 255;        
 }
 
 #endif
@@ -26,6 +26,10 @@
 #include <cstdio>
 #include <vector>
 #include <string>
+#include <memory>
+#include "PixelAllocator.h"
+#include "MappedFile.h"
+#include "RowProgress.h"
 
 /**
    A convenience union to access individual components of a pixel. For
@@ -42,6 +46,14 @@ typedef union Pix {
     unsigned int rgba;
 } Pixel;
 
+/**
+   The flat buffer type used to hold the pixels of an image. The
+   PixelAllocator provides aligned, optionally huge-page backed
+   storage that is not zero-filled on resize. Substitute a different
+   allocator here to change how all image buffers are obtained.
+*/
+using PixelBuffer = std::vector<unsigned char, PixelAllocator<unsigned char>>;
+
 class PNG {
 public:
     /** The default constructor which creates an empty PNG image in memory.
@@ -68,6 +80,23 @@ public:
 	*/
     PNG& operator=(const PNG& src);
 
+	/**
+	   Move constructor. The pixel buffer is taken over from src
+	   without copying and src is left as an empty image.
+
+	   \param[in,out] src The source PNG image whose buffers are to
+	   be moved into this image.
+	*/
+    PNG(PNG&& src) noexcept;
+
+	/**
+	   Move assignment operator.
+
+	   \param[in,out] src The source PNG whose buffers are to be
+	   moved into this image. src is left as an empty image.
+	*/
+    PNG& operator=(PNG&& src) noexcept;
+
     /**
        The destructor frees the dynamic memory allocated to the
        various instance variables encapsulated by this class.
@@ -86,6 +115,9 @@ public:
 
         \param[in] height The height of the image.
 
+        \throws std::runtime_error If the size is negative or a row
+        would have more than INT_MAX bytes.
+
         \see getImage
     */
     void create(int width, int height);
@@ -102,6 +134,47 @@ public:
     */
     void load(const std::string& fileName);
 
+    /** \brief Open and load the specified PNG, reporting progress as
+        rows are decoded.
+
+        This method is typically called from a separate (producer)
+        thread. The size of the image is reported to progress as soon
+        as the header has been read and the pixel buffer has been
+        allocated. Subsequently, the number of rows decoded is
+        published to progress. Interlaced images can only be published
+        once they are fully decoded.
+
+        \param[in] fileName The path to the PNG file from where the
+        image is to be loaded.
+
+        \param[in,out] progress The object to which the progress of
+        loading the image is to be reported.
+    */
+    void load(const std::string& fileName, RowProgress& progress);
+
+    /** \brief Use pixels that are already present in a memory-mapped
+        file as the pixels of this image.
+
+        This method does not copy the pixels. Instead, the image
+        refers directly to the mapped bytes (and keeps the mapping
+        alive).  Since the mapping is private, modifications to the
+        image (such as drawing boxes) do not change the file.
+
+        \param[in] file The memory-mapped file containing the pixels.
+
+        \param[in] offset The offset (in bytes) of the first pixel in
+        the mapped file. The pixels must be in RGBA, row-major format.
+
+        \param[in] width The width of the image.
+
+        \param[in] height The height of the image.
+
+        \throws std::runtime_error If the file is too small to contain
+        the specified image.
+    */
+    void attach(const std::shared_ptr<MappedFile>& file, size_t offset,
+                int width, int height);
+
     /** \brief Write the image from internal buffers to a given PNG
         file.
 
@@ -133,7 +206,7 @@ public:
         on the width, height, and number of bytes per pixel.
 
      */
-    int getBufferSize() const;
+    size_t getBufferSize() const;
 
     /** Return the pixel at a given location.
 
@@ -143,21 +216,38 @@ public:
         \return The Pixel (red, gree, blue, alpha) at the given location.
     */
     Pixel getPixel(const int row, const int col) const {
-        const int idx = (row * width + col) * 4;
+        const size_t idx = (size_t(row) * width + col) * 4;
         const unsigned int* pix = 
-            reinterpret_cast<const unsigned int*>(flatImageBuffer.data() + idx);
+            reinterpret_cast<const unsigned int*>(pixels + idx);
         return Pixel{ .rgba = *pix };
     }
     
+    /** Obtain a pointer to the first pixel in this image.
+
+        The pixels are stored in RGBA, row-major format.  Unlike
+        getBuffer(), this method works for both images that own their
+        buffer and images attached to a memory-mapped file.
+
+        \return A pointer to getBufferSize() bytes of pixel data.
+    */
+    inline const unsigned char* getPixels() const { return pixels; }
+
+    /** Obtain a mutable pointer to the first pixel in this image.
+
+        \return A pointer to getBufferSize() bytes of pixel data.
+    */
+    inline unsigned char* getPixels() { return pixels; }
+
     /** Get an immutable reference to the flat buffer image.
 
         The pixels associated with this image. Each pixel is in RGBA
-        format.  The pixels are stored in a row-major format.
+        format.  The pixels are stored in a row-major format. The
+        buffer is empty if the image is attached to a mapped file.
         
         \return A reference to the flat image buffer that contains the
         pixels.
     */
-    inline const std::vector<unsigned char>& getBuffer() const
+    inline const PixelBuffer& getBuffer() const
     { return flatImageBuffer; }
 
     /** Get an mutable reference to the flat buffer image.
@@ -168,7 +258,7 @@ public:
         \return A reference to the flat image buffer that contains the
         pixels.
     */    
-    inline std::vector<unsigned char>& getBuffer() { return flatImageBuffer; }
+    inline PixelBuffer& getBuffer() { return flatImageBuffer; }
 
 	/** Set a given pixel in the PNG image to red color.
 
@@ -191,10 +281,13 @@ protected:
 
         \param[in] fileName A relative or absolute path to the PNG file
 
+        \param[in,out] progress An optional object to which the progress
+        of loading the image is to be reported.
+
         \throws std::runtime_error If the the file specified cannot be
         read or is not a PNG file.
     */
-    void open(const char* fileName);
+    void open(const char* fileName, RowProgress* progress = NULL);
 
     /** Loads the actual image via calls to libpng.
 
@@ -205,8 +298,12 @@ protected:
 
         \param[in,out] libpngHandle The handle to be used to read the
         actual image data.
+
+        \param[in,out] progress An optional object to which the progress
+        of loading the image is to be reported.
     */
-    void load(png_structp libpngHandle, png_infop pngInfo);
+    void load(png_structp libpngHandle, png_infop pngInfo,
+              RowProgress* progress = NULL);
 
 
     /** Resize the flatImageBuffer vector to contain all the pixels in
@@ -214,10 +311,16 @@ protected:
 
         This is a convenience method that is used to setup the
         necessary buffer size and establish the cross reference
-        pointers used internally by this PNG object.
+        pointers used internally by this PNG object. The contents of
+        the buffer are not initialized.
     */
     void prepareBuffer();
 
+    /** Set up the rowPointers to refer to the rows of pixels in
+        the current flatImageBuffer or mapped file.
+    */
+    void setRowPointers();
+
     /** Create read/write png handle and setup jump handle as required
         by libPNG.
 
@@ -290,7 +393,7 @@ private:
         image. Each pixel is a 32-bit number that contains data in
         RGBA format. The pixels are stored in row major format.
     */
-    std::vector<unsigned char> flatImageBuffer;
+    PixelBuffer flatImageBuffer;
 
     /**
        Pointers to the starting entry in each row of the image. This
@@ -298,6 +401,17 @@ private:
        images  to-and-from files.
     */
     std::vector<unsigned char*> rowPointers;
+
+    /** Pointer to the first pixel in the image. This points either to
+        the first entry in flatImageBuffer or into the mapped file.
+    */
+    unsigned char* pixels;
+
+    /** The memory-mapped file that holds the pixels for this image,
+        if attach() has been used. This is NULL if this image owns its
+        pixels in flatImageBuffer.
+    */
+    std::shared_ptr<MappedFile> mappedFile;
 };
 
 #endif
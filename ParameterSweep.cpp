@@ -0,0 +1,218 @@
+#ifndef PARAMETER_SWEEP_CPP
+#define PARAMETER_SWEEP_CPP
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <atomic>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include "ParameterSweep.h"
+#include "ScoringPolicies.h"
+
+namespace {
+    /** Helper to select the kernel that scores several tolerances. */
+    template<int Width>
+    MultiToleranceScorer selectMultiScorer(const int channels,
+                                           const bool isMask) {
+        if (channels == 1) {
+            return isMask ? scoreStripTolerances<1, true, Width> :
+                scoreStripTolerances<1, false, Width>;
+        }
+        return isMask ? scoreStripTolerances<3, true, Width> :
+            scoreStripTolerances<3, false, Width>;
+    }
+}
+
+ParameterSweep::ParameterSweep(const PNG& mask, bool isMask,
+                               ScoreMetric metric, int channels,
+                               const std::vector<int>& percents,
+                               const std::vector<int>& tolerances) :
+    mask(mask), metric(metric), percents(percents), tolerances(tolerances) {
+    if (percents.empty() || tolerances.empty() ||
+        (percents.size() * tolerances.size() > MaxCombinations)) {
+        throw std::invalid_argument("A sweep must have 1 to " +
+                                    std::to_string(MaxCombinations) +
+                                    " combinations of parameters");
+    }
+    for (const int tol : tolerances) {
+        kernels.push_back(std::make_unique<SearchKernel>(mask, isMask,
+            metric, channels, percents.front(), tol));
+    }
+    for (const int pct : percents) {
+        for (const int tol : tolerances) {
+            thresholds.push_back(SearchKernel(mask, isMask, metric, channels,
+                                              pct, tol).getThreshold());
+        }
+    }
+    if (metric == ScoreMetric::Tolerance) {
+        multiScorer      = selectMultiScorer<1>(channels, isMask);
+        multiStripScorer = selectMultiScorer<StripWidth>(channels, isMask);
+    }
+}
+
+std::vector<ParameterSweep::Candidate>
+ParameterSweep::scoreRow(const PNG& img, const int row,
+                         const int numCols) const {
+    const int numTols = tolerances.size(), numCombos = thresholds.size();
+    const SearchTemplate& tmpl = kernels.front()->getTemplate();
+    const int stride = img.getWidth() * 4;
+    std::vector<Candidate> result;
+    // Scores of a strip of windows. Entry t * width + j is the score of
+    // the j'th window in the strip for the t'th tolerance.
+    float scores[MaxCombinations * StripWidth];
+    int   counts[MaxCombinations * StripWidth];
+    for (int col = 0, width = 1; (col < numCols); col += width) {
+        const unsigned char* pix = img.getPixels() + size_t(row) * stride +
+            col * 4;
+        width = 1;
+        if ((multiStripScorer != NULL) && (col + StripWidth <= numCols)) {
+            width = StripWidth;
+            multiStripScorer(pix, stride, tmpl, tolerances.data(), numTols,
+                             counts);
+            std::copy_n(counts, numTols * width, scores);
+        } else if (multiScorer != NULL) {
+            multiScorer(pix, stride, tmpl, tolerances.data(), numTols,
+                        counts);
+            std::copy_n(counts, numTols, scores);
+        } else {
+            for (int t = 0; (t < numTols); t++) {
+                scores[t] = kernels[t]->score(img, row, col);
+            }
+        }
+        for (int j = 0; (j < width); j++) {
+            uint64_t combos = 0;
+            for (int combo = 0; (combo < numCombos); combo++) {
+                const float score = scores[(combo % numTols) * width + j];
+                combos |= uint64_t(score > thresholds[combo]) << combo;
+            }
+            if (combos != 0) {
+                result.push_back({col + j, combos});
+            }
+        }
+    }
+    return result;
+}
+
+MatchedRectList
+ParameterSweep::select(const int combo, const int numCols) const {
+    const int width = mask.getWidth(), height = mask.getHeight();
+    // Windows (in the current or later rows) in a column overlap an
+    // earlier match if they start at or before this row.
+    std::vector<int> blockedUntil(numCols, -1);
+    MatchedRectList result;
+    for (size_t row = 0; (row < candidates.size()); row++) {
+        for (const Candidate& cand : candidates[row]) {
+            if ((((cand.combos >> combo) & 1) == 0) ||
+                (int(row) <= blockedUntil[cand.col])) {
+                continue;  // Not a match or overlaps an earlier match
+            }
+            result.push_back(MatchedRect(row, cand.col, width, height));
+            // Same overlap test as MatchedRect::intersects()
+            const int endCol = std::min(numCols - 1, cand.col + width);
+            for (int col = std::max(0, cand.col - width); (col <= endCol);
+                 col++) {
+                blockedUntil[col] = std::max<int>(blockedUntil[col],
+                                                  row + height);
+            }
+        }
+    }
+    return result;
+}
+
+bool
+ParameterSweep::run(const PNG& img, RowProgress& progress) {
+    const int numRows = std::max(img.getHeight() - mask.getHeight() + 1, 0);
+    const int numCols = std::max(img.getWidth()  - mask.getWidth()  + 1, 0);
+    candidates.assign(numRows, {});
+    std::atomic<bool> failed{false};
+#pragma omp parallel for default(shared) schedule(runtime)
+    for (int row = 0; (row < numRows); row++) {
+        if (failed || !progress.waitFor(row + mask.getHeight())) {
+            failed = true;
+            continue;  // Decoding failed (reported by the caller)
+        }
+        candidates[row] = scoreRow(img, row, numCols);
+    }
+    if (failed) {
+        return false;
+    }
+    numWindows = uint64_t(numRows) * numCols;
+    // The combinations are independent of each other.
+    matches.assign(thresholds.size(), MatchedRectList());
+#pragma omp parallel for schedule(dynamic)
+    for (size_t combo = 0; combo < thresholds.size(); combo++) {
+        matches[combo] = select(combo, numCols);
+    }
+    return true;
+}
+
+void
+ParameterSweep::report(std::ostream& os) const {
+    os << "Parameter sweep of " << numWindows << " windows for "
+       << percents.size() << " percentages and " << tolerances.size()
+       << " tolerances\n" << "Percent\tTolerance\tThreshold\tMatches\n";
+    for (size_t p = 0, combo = 0; (p < percents.size()); p++) {
+        for (size_t t = 0; (t < tolerances.size()); t++, combo++) {
+            os << percents[p] << '\t' << tolerances[t] << '\t'
+               << thresholds[combo] << '\t' << matches[combo].size() << '\n';
+        }
+    }
+    for (size_t p = 0, combo = 0; (p < percents.size()); p++) {
+        for (size_t t = 0; (t < tolerances.size()); t++, combo++) {
+            os << "Matches for percent " << percents[p] << " and tolerance "
+               << tolerances[t] << ": " << matches[combo].size() << '\n'
+               << matches[combo];
+        }
+    }
+    os << std::flush;
+}
+
+std::vector<int>
+ParameterSweep::parseList(const std::string& spec) {
+    std::vector<int> values;
+    std::istringstream is(spec);
+    if (spec.find(':') != std::string::npos) {
+        int min, max, step;
+        char colon;
+        if (!(is >> min >> colon >> max >> colon >> step) || (step <= 0)) {
+            throw std::invalid_argument("Invalid range of values: " + spec);
+        }
+        for (int value = min; (value <= max); value += step) {
+            values.push_back(value);
+        }
+    } else {
+        int value;
+        char sep = ',';
+        while ((sep == ',') && (is >> value)) {
+            values.push_back(value);
+            is >> sep;
+        }
+    }
+    if (values.empty()) {
+        throw std::invalid_argument("Invalid list of values: " + spec);
+    }
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    return values;
+}
+
+#endif
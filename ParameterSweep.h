@@ -0,0 +1,170 @@
+#ifndef PARAMETER_SWEEP_H
+#define PARAMETER_SWEEP_H
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <iostream>
+#include "PNG.h"
+#include "SearchKernel.h"
+#include "MatchedRect.h"
+#include "RowProgress.h"
+
+/**
+   Signature of the kernels that score a strip of windows with the
+   tolerance metric for several tolerances. See scoreStripTolerances()
+   in ScoringPolicies.h.
+*/
+using MultiToleranceScorer = void (*)(const unsigned char* img, int stride,
+                                      const SearchTemplate& tmpl,
+                                      const int* tolerances,
+                                      int numTolerances, int* scores);
+
+/**
+   A sweep over many combinations of match percentage and tolerance in
+   a single pass over the image, for tuning these parameters for a new
+   mask. Each window is scored once per tolerance (for the tolerance
+   metric, the scores for all the tolerances are computed in one pass
+   over the window). The windows that match any combination are
+   recorded along with the combinations they match. The matches for
+   each combination are then derived by the same greedy row-major
+   selection of non-overlapping windows as the regular search, without
+   scoring any window again.
+*/
+class ParameterSweep {
+public:
+    /** The maximum number of combinations in a sweep. */
+    static constexpr int MaxCombinations = 64;
+
+    /** Setup a sweep for the given mask.
+
+        \param[in] mask The mask (or sub-image) to be searched for. The
+        mask must remain valid while this sweep is in use.
+
+        \param[in] isMask If true, mask is a black-and-white mask.
+
+        \param[in] metric The metric used to score windows.
+
+        \param[in] channels The number of channels compared (1 or 3).
+
+        \param[in] percents The match percentages to be swept.
+
+        \param[in] tolerances The tolerances to be swept.
+
+        \throws std::invalid_argument If either list is empty or if
+        there are more than MaxCombinations combinations.
+    */
+    ParameterSweep(const PNG& mask, bool isMask, ScoreMetric metric,
+                   int channels, const std::vector<int>& percents,
+                   const std::vector<int>& tolerances);
+
+    /** Score all the windows of the image and derive the matches for
+        each combination. Rows are scored in parallel as soon as they
+        have been decoded.
+
+        \param[in] img The image being searched.
+
+        \param[in] progress The progress of decoding img.
+
+        \return This method returns false if decoding the image failed.
+    */
+    bool run(const PNG& img, RowProgress& progress);
+
+    /** Print a table with the number of matches for each combination
+        followed by the matches for each combination.
+
+        \param[out] os The stream to which the results are written.
+    */
+    void report(std::ostream& os) const;
+
+    /** The matches for the given combination (valid after run()). */
+    const MatchedRectList& getMatches(const int percentIdx,
+                                      const int toleranceIdx) const {
+        return matches.at(percentIdx * tolerances.size() + toleranceIdx);
+    }
+
+    /** Parse a list of integers, specified either as comma-separated
+        values ("50,60,75") or as a range ("min:max:step").
+
+        \return The values in ascending order without duplicates.
+
+        \throws std::invalid_argument If the list is not valid.
+    */
+    static std::vector<int> parseList(const std::string& spec);
+
+private:
+    /** A window that matches at least one combination. */
+    struct Candidate {
+        /** The left column of the window. */
+        int col;
+        /** Bit p * tolerances.size() + t is set if the window matches
+            the combination of percents[p] and tolerances[t].
+        */
+        uint64_t combos;
+    };
+
+    /** Score the windows starting in a row and return the candidates. */
+    std::vector<Candidate> scoreRow(const PNG& img, const int row,
+                                    const int numCols) const;
+
+    /** Greedily select the non-overlapping candidates that match the
+        given combination, in row-major order.
+    */
+    MatchedRectList select(const int combo, const int numCols) const;
+
+    /** The mask being searched for. */
+    const PNG& mask;
+
+    /** The metric used to score windows. */
+    const ScoreMetric metric;
+
+    /** The match percentages and tolerances being swept. */
+    const std::vector<int> percents, tolerances;
+
+    /** A kernel for each tolerance (with the lowest match percentage). */
+    std::vector<std::unique_ptr<SearchKernel>> kernels;
+
+    /** The threshold for each combination. */
+    std::vector<float> thresholds;
+
+    /** Kernels that score a single window and a strip of StripWidth
+        windows for all the tolerances in one pass (only used for the
+        tolerance metric).
+    */
+    MultiToleranceScorer multiScorer = NULL, multiStripScorer = NULL;
+
+    /** The number of windows scored by multiStripScorer. */
+    static constexpr int StripWidth = 16;
+
+    /** The candidates in each row of windows. */
+    std::vector<std::vector<Candidate>> candidates;
+
+    /** The matches for each combination. */
+    std::vector<MatchedRectList> matches;
+
+    /** The number of windows scored by run(). */
+    uint64_t numWindows = 0;
+};
+
+#endif
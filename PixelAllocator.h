@@ -0,0 +1,197 @@
+#ifndef PIXEL_ALLOCATOR_H
+#define PIXEL_ALLOCATOR_H
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <sys/mman.h>
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+#include <string>
+#include <utility>
+#include <stdexcept>
+
+/**
+   The different strategies that can be used to back large pixel
+   buffers with huge pages.  Huge pages reduce the number of TLB
+   misses when a search sweeps over a large image.
+*/
+enum class HugePageMode {
+    None,         ///< Regular 4 KiB pages only.
+    Transparent,  ///< Ask the kernel for transparent huge pages (THP).
+    Explicit      ///< Use MAP_HUGETLB, falling back to THP on failure.
+};
+
+/**
+   Process-wide settings used by PixelAllocator. These are static so
+   that the allocator itself remains stateless (and hence buffers can
+   be freely moved between images).
+*/
+class PixelBufferPolicy {
+public:
+    /** The alignment (in bytes) of every pixel buffer. A cache line
+        is sufficient for aligned vector loads of a full row.
+    */
+    static constexpr size_t Alignment = 64;
+
+    /** Buffers of this size or larger are obtained via mmap and are
+        candidates for huge pages. Smaller buffers use aligned_alloc.
+    */
+    static constexpr size_t HugePageSize = 2 * 1024 * 1024;
+
+    /** The huge page strategy used for new large buffers. */
+    static inline HugePageMode hugePages = HugePageMode::Transparent;
+
+    /** Convenience method to set the huge page mode from a string
+        ("none", "thp", or "explicit") typically supplied on the
+        command-line.
+
+        \param[in] mode The name of the mode to be used.
+
+        \throws std::invalid_argument If the mode is not recognized.
+    */
+    static void setHugePages(const std::string& mode) {
+        if (mode == "none") {
+            hugePages = HugePageMode::None;
+        } else if (mode == "thp") {
+            hugePages = HugePageMode::Transparent;
+        } else if (mode == "explicit") {
+            hugePages = HugePageMode::Explicit;
+        } else {
+            throw std::invalid_argument("Invalid huge page mode: " + mode);
+        }
+    }
+};
+
+/**
+   A minimal standard-conforming allocator for pixel buffers.
+
+   Compared to std::allocator this allocator: (1) aligns every buffer
+   to PixelBufferPolicy::Alignment, (2) backs large buffers with
+   huge pages when enabled, and (3) default-initializes (rather than
+   value-initializes) elements. The last point means that resizing a
+   std::vector using this allocator does not zero-fill memory that
+   libpng is about to overwrite anyway.
+*/
+template<typename T>
+class PixelAllocator {
+public:
+    using value_type = T;
+
+    PixelAllocator() noexcept = default;
+
+    template<typename U>
+    PixelAllocator(const PixelAllocator<U>&) noexcept {}
+
+    /** Allocate an aligned buffer for n elements.
+
+        \param[in] n The number of elements to allocate.
+
+        \return Pointer to the newly allocated (uninitialized) buffer.
+    */
+    T* allocate(const size_t n) {
+        const size_t bytes = n * sizeof(T);
+        if (bytes >= PixelBufferPolicy::HugePageSize) {
+            return static_cast<T*>(mapBuffer(mappedSize(bytes)));
+        }
+        void* buf = std::aligned_alloc(PixelBufferPolicy::Alignment,
+                                       roundUp(bytes,
+                                               PixelBufferPolicy::Alignment));
+        if (buf == NULL) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(buf);
+    }
+
+    /** Free a buffer previously obtained from allocate(). The size
+        decides how the buffer was obtained, so it must be the same
+        value that was passed to allocate().
+    */
+    void deallocate(T* buf, const size_t n) noexcept {
+        const size_t bytes = n * sizeof(T);
+        if (bytes >= PixelBufferPolicy::HugePageSize) {
+            munmap(buf, mappedSize(bytes));
+        } else {
+            std::free(buf);
+        }
+    }
+
+    /** Default-initialize an element. For pixel bytes this is a
+        no-op, which is the whole point.
+    */
+    template<typename U>
+    void construct(U* ptr) noexcept(noexcept(U())) {
+        ::new(static_cast<void*>(ptr)) U;
+    }
+
+    /** Construct an element from the given arguments (used when
+        copying or inserting values).
+    */
+    template<typename U, typename... Args>
+    void construct(U* ptr, Args&&... args) {
+        ::new(static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+    }
+
+    template<typename U>
+    bool operator==(const PixelAllocator<U>&) const noexcept { return true; }
+
+    template<typename U>
+    bool operator!=(const PixelAllocator<U>&) const noexcept { return false; }
+
+private:
+    static size_t roundUp(const size_t bytes, const size_t unit) {
+        return (bytes + unit - 1) / unit * unit;
+    }
+
+    static size_t mappedSize(const size_t bytes) {
+        return roundUp(bytes, PixelBufferPolicy::HugePageSize);
+    }
+
+    /** Helper method to obtain an anonymous mapping of the given
+        size, using huge pages as configured in PixelBufferPolicy.
+    */
+    static void* mapBuffer(const size_t len) {
+        const int prot  = PROT_READ | PROT_WRITE;
+        const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+        void* buf = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        if (PixelBufferPolicy::hugePages == HugePageMode::Explicit) {
+            // This fails if no huge pages have been reserved by the
+            // administrator. In that case we fall back to THP.
+            buf = mmap(NULL, len, prot, flags | MAP_HUGETLB, -1, 0);
+        }
+#endif
+        if (buf == MAP_FAILED) {
+            buf = mmap(NULL, len, prot, flags, -1, 0);
+            if (buf == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+#ifdef MADV_HUGEPAGE
+            if (PixelBufferPolicy::hugePages != HugePageMode::None) {
+                madvise(buf, len, MADV_HUGEPAGE);
+            }
+#endif
+        }
+        return buf;
+    }
+};
+
+#endif
@@ -0,0 +1,311 @@
+#ifndef RAW_IMAGE_CPP
+#define RAW_IMAGE_CPP
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <cctype>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include "RawImage.h"
+
+namespace {
+    /** Determine if str starts with the given prefix. */
+    bool startsWith(const std::string& str, const std::string& prefix) {
+        return str.compare(0, prefix.size(), prefix) == 0;
+    }
+
+    /** Determine if str ends with the given suffix. */
+    bool endsWith(const std::string& str, const std::string& suffix) {
+        return (str.size() >= suffix.size()) &&
+            (str.compare(str.size() - suffix.size(), suffix.size(),
+                         suffix) == 0);
+    }
+}
+
+bool
+RawImage::isRaw(const std::string& spec) {
+    for (const char* type : {"raw:", "ppm:", "pgm:", "pam:"}) {
+        if (startsWith(spec, type)) {
+            return true;
+        }
+    }
+    return endsWith(spec, ".ppm") || endsWith(spec, ".pgm") ||
+        endsWith(spec, ".pam");
+}
+
+RawImage::Spec
+RawImage::parse(const std::string& spec) {
+    Spec result{PAM, 0, 0, spec};
+    if (startsWith(spec, "raw:")) {
+        // Split "raw:WxH:format:path" into its parts.
+        const size_t fmtPos  = spec.find(':', 4);
+        const size_t pathPos = (fmtPos == std::string::npos) ?
+            fmtPos : spec.find(':', fmtPos + 1);
+        char sep = 0;
+        std::istringstream dims(spec.substr(4, fmtPos - 4));
+        if ((pathPos == std::string::npos) ||
+            !(dims >> result.width >> sep >> result.height) || (sep != 'x') ||
+            (result.width <= 0) || (result.height <= 0)) {
+            throw std::runtime_error("Invalid raw image (" + spec + "). "
+                                     "Expected raw:WxH:rgba|rgb|gray:path");
+        }
+        const std::string format = spec.substr(fmtPos + 1,
+                                               pathPos - fmtPos - 1);
+        if (format == "rgba") {
+            result.format = RGBA;
+        } else if (format == "rgb") {
+            result.format = RGB;
+        } else if (format == "gray") {
+            result.format = Gray;
+        } else {
+            throw std::runtime_error("Invalid raw pixel format: " + format);
+        }
+        result.path = spec.substr(pathPos + 1);
+    } else if (startsWith(spec, "ppm:") || endsWith(spec, ".ppm")) {
+        result.format = PPM;
+    } else if (startsWith(spec, "pgm:") || endsWith(spec, ".pgm")) {
+        result.format = PGM;
+    } else if (!startsWith(spec, "pam:") && !endsWith(spec, ".pam")) {
+        throw std::runtime_error("Invalid raw image: " + spec);
+    }
+    if (startsWith(spec, "ppm:") || startsWith(spec, "pgm:") ||
+        startsWith(spec, "pam:")) {
+        result.path = spec.substr(4);
+    }
+    return result;
+}
+
+int
+RawImage::readHeader(const std::function<int()>& next, int& width,
+                     int& height) {
+    const int magic1 = next(), magic2 = next();
+    int depth = (magic2 == '5') ? 1 : 3, maxVal = 0;
+    width = height = 0;
+    if ((magic1 != 'P') || ((magic2 != '5') && (magic2 != '6') &&
+                            (magic2 != '7'))) {
+        throw std::runtime_error("Not a PGM (P5), PPM (P6), or PAM (P7) "
+                                 "image");
+    }
+    if (magic2 == '7') {
+        // A PAM header consists of lines of "KEYWORD value".
+        for (std::string key; (key != "ENDHDR");) {
+            std::string line;
+            int ch;
+            while (((ch = next()) != '\n') && (ch != EOF)) {
+                line.push_back(ch);
+            }
+            std::istringstream is(line);
+            key.clear();
+            is >> key;
+            if (key == "WIDTH") {
+                is >> width;
+            } else if (key == "HEIGHT") {
+                is >> height;
+            } else if (key == "DEPTH") {
+                is >> depth;
+            } else if (key == "MAXVAL") {
+                is >> maxVal;
+            } else if ((ch == EOF) && (key != "ENDHDR")) {
+                throw std::runtime_error("Truncated PAM header");
+            }
+        }
+    } else {
+        // Width, height, and maximum value separated by white space or
+        // comments. A single white space follows the maximum value.
+        for (int* value : {&width, &height, &maxVal}) {
+            int ch = next();
+            while (std::isspace(ch) || (ch == '#')) {
+                if (ch == '#') {
+                    // Skip the comment up to the end of the line.
+                    while ((ch != '\n') && (ch != EOF)) {
+                        ch = next();
+                    }
+                }
+                ch = next();
+            }
+            for (; std::isdigit(ch); ch = next()) {
+                if (*value > INT_MAX / 10) {
+                    throw std::runtime_error("Invalid Netpbm header");
+                }
+                *value = *value * 10 + (ch - '0');
+            }
+        }
+    }
+    if ((width <= 0) || (height <= 0) || (depth < 1) || (depth > 4) ||
+        (maxVal != 255)) {
+        throw std::runtime_error("Unsupported Netpbm image. Only 8-bit "
+                                 "samples (maxval 255) are supported");
+    }
+    return depth;
+}
+
+void
+RawImage::toRGBA(const unsigned char* src, int depth, int width,
+                 unsigned char* dst) {
+    if (depth == 4) {
+        std::memcpy(dst, src, size_t(width) * 4);
+        return;
+    }
+    for (int col = 0; (col < width); col++, src += depth, dst += 4) {
+        dst[0] = src[0];
+        dst[1] = (depth >= 3) ? src[1] : src[0];
+        dst[2] = (depth >= 3) ? src[2] : src[0];
+        dst[3] = (depth == 2) ? src[1] : 255;
+    }
+}
+
+void
+RawImage::load(const std::string& spec, PNG& img, RowProgress* progress) {
+    const Spec info = parse(spec);
+    int width = info.width, height = info.height;
+    int depth = (info.format == RGBA) ? 4 : (info.format == RGB) ? 3 : 1;
+    const bool isNetpbm = (info.format == PPM) || (info.format == PGM) ||
+        (info.format == PAM);
+    if (info.path != "-") {
+        auto file = std::make_shared<MappedFile>(info.path);
+        size_t offset = 0;
+        if (isNetpbm) {
+            depth = readHeader([&file, &offset]() {
+                    return (offset < file->size()) ?
+                        int(file->data()[offset++]) : EOF; }, width, height);
+        }
+        const size_t rowBytes = size_t(width) * depth;
+        if (offset + rowBytes * height > file->size()) {
+            throw std::runtime_error("Raw image (" + info.path + ") is too "
+                                     "small for its dimensions");
+        }
+        if ((depth == 4) && (offset % 4 == 0)) {
+            // Use the mapped RGBA pixels directly.
+            img.attach(file, offset, width, height);
+            if (progress != NULL) {
+                progress->setSize(width, height);
+                progress->publish(height);
+            }
+            return;
+        }
+        img.create(width, height);
+        if (progress != NULL) {
+            progress->setSize(width, height);
+        }
+        for (int row = 0; (row < height); row++) {
+            toRGBA(file->data() + offset + row * rowBytes, depth, width,
+                   img.getPixels() + size_t(row) * width * 4);
+            if (progress != NULL) {
+                progress->publish(row + 1);
+            }
+        }
+        return;
+    }
+    // Read the pixels from the standard input, row by row.
+    if (isNetpbm) {
+        depth = readHeader([]() { return getchar(); }, width, height);
+    }
+    img.create(width, height);
+    if (progress != NULL) {
+        progress->setSize(width, height);
+    }
+    std::vector<unsigned char> buf(size_t(width) * depth);
+    for (int row = 0; (row < height); row++) {
+        unsigned char* const dst = img.getPixels() + size_t(row) * width * 4;
+        unsigned char* const src = (depth == 4) ? dst : buf.data();
+        if (fread(src, depth, width, stdin) != size_t(width)) {
+            throw std::runtime_error("Unexpected end of raw image on "
+                                     "standard input");
+        }
+        if (depth != 4) {
+            toRGBA(src, depth, width, dst);
+        }
+        if (progress != NULL) {
+            progress->publish(row + 1);
+        }
+    }
+}
+
+void
+RawImage::write(const std::string& spec, const PNG& img) {
+    const Spec info = parse(spec);
+    const int width = img.getWidth(), height = img.getHeight();
+    if ((info.width != 0) &&
+        ((info.width != width) || (info.height != height))) {
+        throw std::runtime_error("The size in " + spec + " does not match "
+                                 "the size of the image (" +
+                                 std::to_string(width) + "x" +
+                                 std::to_string(height) + ")");
+    }
+    int depth = 4;
+    std::string header;
+    const std::string dims = std::to_string(width) + " " +
+        std::to_string(height) + "\n";
+    switch (info.format) {
+    case RGB:  depth = 3; break;
+    case Gray: depth = 1; break;
+    case PPM:  depth = 3; header = "P6\n" + dims + "255\n"; break;
+    case PGM:  depth = 1; header = "P5\n" + dims + "255\n"; break;
+    case PAM:
+        header = "P7\nWIDTH " + std::to_string(width) + "\nHEIGHT " +
+            std::to_string(height) + "\nDEPTH 4\nMAXVAL 255\n"
+            "TUPLTYPE RGB_ALPHA\n";
+        // Pad the header with a comment so that the pixels are 4-byte
+        // aligned and can be attached without copying when loaded.
+        if ((header.size() + 7) % 4 != 0) {
+            const size_t pad = 4 - (header.size() + 7) % 4;
+            header += "#" + std::string((pad < 2) ? pad + 2 : pad - 2, ' ') +
+                "\n";
+        }
+        header += "ENDHDR\n";
+        break;
+    default: break;
+    }
+    FILE* fp = (info.path == "-") ? stdout : fopen(info.path.c_str(), "wb");
+    if (fp == NULL) {
+        throw std::runtime_error("Raw image (" + info.path + ") could not "
+                                 "be opened for writing");
+    }
+    bool ok = (fwrite(header.data(), 1, header.size(), fp) == header.size());
+    if (depth == 4) {
+        const size_t size = img.getBufferSize();
+        ok = ok && (fwrite(img.getPixels(), 1, size, fp) == size);
+    }
+    std::vector<unsigned char> buf(size_t(width) * depth);
+    for (int row = 0; (row < height) && (depth != 4) && ok; row++) {
+        const unsigned char* src = img.getPixels() + size_t(row) * width * 4;
+        for (int col = 0; (col < width); col++, src += 4) {
+            if (depth == 3) {
+                std::memcpy(&buf[col * 3], src, 3);
+            } else {
+                // Luma with integer BT.601 weights.
+                buf[col] = (77 * src[0] + 150 * src[1] + 29 * src[2] +
+                            128) >> 8;
+            }
+        }
+        ok = (fwrite(buf.data(), 1, buf.size(), fp) == buf.size());
+    }
+    ok = ((fp == stdout) ? fflush(fp) : fclose(fp)) == 0 && ok;
+    if (!ok) {
+        throw std::runtime_error("Error writing raw image " + info.path);
+    }
+}
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef RAW_IMAGE_H
+#define RAW_IMAGE_H
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <string>
+#include <functional>
+#include "PNG.h"
+#include "RowProgress.h"
+
+/**
+   Helper to read and write images as uncompressed pixels, bypassing
+   the deflate/inflate of PNG files. An image is identified by a
+   specification of one of the forms:
+
+   - raw:WxH:rgba|rgb|gray:path -- headerless pixels (4, 3, or 1
+     bytes per pixel) in row-major order.
+
+   - ppm:path, pgm:path, pam:path, or a path ending in .ppm, .pgm, or
+     .pam -- Netpbm files (P6, P5, or P7 with 8-bit samples).  When
+     loading, the actual format is taken from the header of the file.
+
+   A path of "-" refers to the standard input (or output).  Files with
+   RGBA pixels (raw rgba or PAM with a depth of 4) are memory-mapped
+   and used without copying. Other pixels are converted to RGBA, with
+   an alpha of 255, as they are read. When writing gray pixels, the
+   luma of each pixel is used.
+*/
+class RawImage {
+public:
+    /** Determine if the given name is a specification of a raw image
+        (instead of the path to a PNG file).
+    */
+    static bool isRaw(const std::string& spec);
+
+    /** Determine if a raw image specification refers to the standard
+        input (or output), that is, has a path of "-".
+    */
+    static bool isStdio(const std::string& spec) {
+        return parse(spec).path == "-";
+    }
+
+    /** Load a raw image.
+
+        \param[in] spec The specification of the image to be loaded.
+
+        \param[out] img The image into which the pixels are loaded.
+
+        \param[in,out] progress An optional object to which the progress
+        of loading the image is to be reported.
+
+        \throws std::runtime_error If the specification is invalid or
+        the image could not be read.
+    */
+    static void load(const std::string& spec, PNG& img,
+                     RowProgress* progress = NULL);
+
+    /** Write an image as raw pixels.
+
+        \param[in] spec The specification of the file to be written.
+
+        \param[in] img The image to be written.
+
+        \throws std::runtime_error If the specification is invalid or
+        the image could not be written.
+    */
+    static void write(const std::string& spec, const PNG& img);
+
+private:
+    /** The formats of raw images. */
+    enum Format { RGBA, RGB, Gray, PPM, PGM, PAM };
+
+    /** The parts of a specification. For Netpbm formats, the width
+        and height are from the header of the file.
+    */
+    struct Spec {
+        Format format;
+        int width, height;
+        std::string path;
+    };
+
+    /** Split a specification into its parts. */
+    static Spec parse(const std::string& spec);
+
+    /** Read the header of a Netpbm file.
+
+        \param[in] next Returns the next byte of the file (or EOF).
+
+        \param[out] width The width of the image.
+
+        \param[out] height The height of the image.
+
+        \return The number of bytes per pixel (1 to 4).
+
+        \throws std::runtime_error If the header is invalid.
+    */
+    static int readHeader(const std::function<int()>& next, int& width,
+                          int& height);
+
+    /** Convert a row of pixels with the given number of bytes per pixel
+        (1: gray, 2: gray and alpha, 3: RGB, 4: RGBA) to RGBA.
+    */
+    static void toRGBA(const unsigned char* src, int depth, int width,
+                       unsigned char* dst);
+};
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef ROW_PROGRESS_H
+#define ROW_PROGRESS_H
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+/**
+   A simple class to track the progress of an image being decoded by
+   a producer thread, so that consumers can start working on rows of
+   the image that have already been decoded.
+
+   The producer first calls setSize() (once the image header has been
+   read and the buffer has been allocated) and then publish() as rows
+   become available. Consumers use waitForSize() and waitFor() to
+   block until the data they need is available.  Checking for rows
+   that are already available is lock-free.
+*/
+class RowProgress {
+public:
+    /** Report the dimensions of the image being decoded. This must
+        be called after the image buffer has been allocated.
+
+        \param[in] width The width of the image.
+
+        \param[in] height The height of the image.
+    */
+    void setSize(const int width, const int height) {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->width  = width;
+        this->height = height;
+        sized = true;
+        cond.notify_all();
+    }
+
+    /** Report that the first rows of the image have been decoded.
+
+        \param[in] rows The total number of rows that are available.
+    */
+    void publish(const int rows) {
+        rowsReady.store(rows);
+        if (waiters.load() > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            cond.notify_all();
+        }
+    }
+
+    /** Report that the producer failed. This wakes up all consumers
+        (their wait methods return false).
+
+        \param[in] error The exception to be reported by rethrow().
+    */
+    void fail(std::exception_ptr error) {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->error = error;
+        failed = true;
+        cond.notify_all();
+    }
+
+    /** Wait until the size of the image is known.
+
+        \return This method returns true once the size is available and
+        false if the producer failed.
+    */
+    bool waitForSize() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [this]{ return sized || failed; });
+        return sized;
+    }
+
+    /** Wait until at least the given number of rows are available.
+
+        \param[in] rows The number of rows (from the top) needed.
+
+        \return This method returns true once the rows are available
+        and false if the producer failed.
+    */
+    bool waitFor(const int rows) {
+        if (rowsReady.load() >= rows) {
+            return true;  // Common case once decoding has progressed.
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        waiters++;
+        cond.wait(lock, [&]{ return (rowsReady.load() >= rows) || failed; });
+        waiters--;
+        return !failed;
+    }
+
+    /** Rethrow the exception reported by the producer (if any). */
+    void rethrow() const {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    /** The width of the image, valid after waitForSize() succeeds. */
+    int getWidth() const { return width; }
+
+    /** The height of the image, valid after waitForSize() succeeds. */
+    int getHeight() const { return height; }
+
+private:
+    /** The number of rows that have been decoded. */
+    std::atomic<int> rowsReady{0};
+
+    /** The number of consumers blocked in waitFor(). */
+    std::atomic<int> waiters{0};
+
+    /** Mutex and condition variable used to block consumers. */
+    std::mutex mutex;
+    std::condition_variable cond;
+
+    /** The size of the image, valid if sized is true. */
+    int width = 0, height = 0;
+    bool sized = false;
+
+    /** Error information reported by the producer. */
+    bool failed = false;
+    std::exception_ptr error;
+};
+
+#endif
@@ -0,0 +1,301 @@
+#ifndef SSD_MAP_CPP
+#define SSD_MAP_CPP
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <cmath>
+#include <cstdint>
+#include <complex>
+#include <stdexcept>
+#include <algorithm>
+#include "SSDMap.h"
+
+namespace {
+    using Complex = std::complex<double>;
+
+    /** Multiply a by the complex conjugate of b. This is written out, as
+        the std::complex operator checks for infinities and NaNs.
+    */
+    inline Complex mulConj(const Complex& a, const Complex& b) {
+        return Complex(a.real() * b.real() + a.imag() * b.imag(),
+                       a.imag() * b.real() - a.real() * b.imag());
+    }
+
+    /** The smallest power of 2 that is at least n. */
+    int nextPow2(const int n) {
+        int pow2 = 1;
+        while (pow2 < n) {
+            pow2 *= 2;
+        }
+        return pow2;
+    }
+
+    /** An in-place radix-2 FFT of a fixed length (a power of 2). */
+    class FFT {
+    public:
+        explicit FFT(const int n) : n(n), twiddles(n / 2), reversed(n) {
+            for (int k = 0; (k < n / 2); k++) {
+                twiddles[k] = std::polar(1.0, -2 * M_PI * k / n);
+            }
+            for (int i = 1, j = 0; (i < n); i++) {
+                // Increment j in bit-reversed order.
+                int bit = n / 2;
+                for (; (j & bit); bit /= 2) {
+                    j ^= bit;
+                }
+                reversed[i] = (j ^= bit);
+            }
+        }
+
+        /** Transform (without scaling the inverse) n values in place. */
+        void transform(Complex* data, const bool inverse) const {
+            for (int i = 0; (i < n); i++) {
+                if (i < reversed[i]) {
+                    std::swap(data[i], data[reversed[i]]);
+                }
+            }
+            for (int len = 2; (len <= n); len *= 2) {
+                const int half = len / 2, step = n / len;
+                for (int start = 0; (start < n); start += len) {
+                    Complex* lo = data + start;
+                    Complex* hi = lo + half;
+                    for (int k = 0; (k < half); k++) {
+                        const Complex& w = twiddles[k * step];
+                        const double wi = inverse ? -w.imag() : w.imag();
+                        const Complex v(hi[k].real() * w.real() -
+                                        hi[k].imag() * wi,
+                                        hi[k].real() * wi +
+                                        hi[k].imag() * w.real());
+                        hi[k] = lo[k] - v;
+                        lo[k] += v;
+                    }
+                }
+            }
+        }
+
+    private:
+        const int n;
+        std::vector<Complex> twiddles;
+        std::vector<int> reversed;
+    };
+
+    /** Transform a width x height array in place. Only the first
+        usedRows rows may be non-zero (before a forward transform).
+    */
+    void transform2D(std::vector<Complex>& data, const int width,
+                     const int height, const int usedRows,
+                     const bool inverse) {
+        const FFT rowFFT(width), colFFT(height);
+#pragma omp parallel for schedule(static)
+        for (int row = 0; row < usedRows; row++) {
+            rowFFT.transform(&data[size_t(row) * width], inverse);
+        }
+        // Columns are transformed in blocks, gathered into contiguous
+        // buffers, to make better use of the cache.
+        constexpr int Block = 8;
+#pragma omp parallel for schedule(static)
+        for (int col = 0; col < width; col += Block) {
+            const int numCols = std::min(Block, width - col);
+            std::vector<Complex> columns(numCols * height);
+            for (int row = 0; (row < height); row++) {
+                for (int j = 0; (j < numCols); j++) {
+                    columns[j * height + row] =
+                        data[size_t(row) * width + col + j];
+                }
+            }
+            for (int j = 0; (j < numCols); j++) {
+                colFFT.transform(&columns[j * height], inverse);
+            }
+            for (int row = 0; (row < height); row++) {
+                for (int j = 0; (j < numCols); j++) {
+                    data[size_t(row) * width + col + j] =
+                        columns[j * height + row];
+                }
+            }
+        }
+    }
+
+    /** Copy two channels of a tile of an image (the second channel may
+        be -1 for none) into the real and imaginary parts of a width x
+        height array. The parts of the tile outside the image are zero.
+    */
+    void pack(const PNG& img, const int row0, const int col0,
+              const int first, const int second, const int width,
+              const int height, std::vector<Complex>& data) {
+        std::fill(data.begin(), data.end(), Complex());
+        const int numRows = std::min(height, img.getHeight() - row0);
+        const int numCols = std::min(width,  img.getWidth()  - col0);
+        for (int row = 0; (row < numRows); row++) {
+            const unsigned char* pix = img.getPixels() +
+                (size_t(row0 + row) * img.getWidth() + col0) * 4;
+            Complex* out = &data[size_t(row) * width];
+            for (int col = 0; (col < numCols); col++, pix += 4) {
+                out[col] = Complex(pix[first], (second < 0) ? 0 : pix[second]);
+            }
+        }
+    }
+}
+
+SSDMap::SSDMap(const PNG& img, const PNG& tmpl, int channels) :
+    rows(std::max(0, img.getHeight() - tmpl.getHeight() + 1)),
+    cols(std::max(0, img.getWidth()  - tmpl.getWidth()  + 1)),
+    ssd(size_t(rows) * cols) {
+    if ((rows > 0) && (cols > 0)) {
+        addSquares(img, tmpl, channels);
+        subtractCorrelation(img, tmpl, channels);
+    }
+}
+
+void
+SSDMap::addSquares(const PNG& img, const PNG& tmpl, int channels) {
+    const auto sumSquares = [channels](const unsigned char* pix) {
+        int sum = 0;
+        for (int c = 0; (c < channels); c++) {
+            sum += pix[c] * pix[c];
+        }
+        return sum;
+    };
+    int64_t tmplSum = 0;
+    for (int i = 0; (i < tmpl.getWidth() * tmpl.getHeight()); i++) {
+        tmplSum += sumSquares(tmpl.getPixels() + i * 4);
+    }
+    const int width = img.getWidth();
+    const int tw = tmpl.getWidth(), th = tmpl.getHeight();
+    // Adds (or subtracts) the squares of a row of the image to the sums.
+    const auto addRow = [&](std::vector<int64_t>& colSums, const int row,
+                            const int sign) {
+        const unsigned char* pix = img.getPixels() + size_t(row) * width * 4;
+        for (int col = 0; (col < width); col++, pix += 4) {
+            colSums[col] += sign * sumSquares(pix);
+        }
+    };
+#pragma omp parallel
+    {
+        // The sums of the squares in each column over the th rows of
+        // the windows in the current row. They are updated as the rows
+        // assigned to this thread are processed in order.
+        std::vector<int64_t> colSums(width);
+        int sumsRow = -1;
+#pragma omp for schedule(static)
+        for (int row = 0; row < rows; row++) {
+            if ((sumsRow < 0) || (row != sumsRow + 1)) {
+                std::fill(colSums.begin(), colSums.end(), 0);
+                for (int i = 0; (i < th); i++) {
+                    addRow(colSums, row + i, 1);
+                }
+            } else {
+                addRow(colSums, row - 1, -1);
+                addRow(colSums, row + th - 1, 1);
+            }
+            sumsRow = row;
+            // Slide the window along the row.
+            int64_t sum = 0;
+            for (int col = 0; (col < tw); col++) {
+                sum += colSums[col];
+            }
+            double* out = &ssd[size_t(row) * cols];
+            for (int col = 0; (col < cols); col++) {
+                out[col] = sum + tmplSum;
+                if (col + tw < width) {
+                    sum += colSums[col + tw] - colSums[col];
+                }
+            }
+        }
+    }
+}
+
+void
+SSDMap::subtractCorrelation(const PNG& img, const PNG& tmpl, int channels) {
+    // The (circular) correlation of a tile of the image with the
+    // sub-image is exact for the windows that lie within the tile. So
+    // the tiles overlap by the size of the sub-image less 1. The tiles
+    // need not be larger than the image.
+    const int th = tmpl.getHeight(), tw = tmpl.getWidth();
+    const int height = std::min(nextPow2(img.getHeight()),
+                                std::max(TileSize, nextPow2(2 * th)));
+    const int width  = std::min(nextPow2(img.getWidth()),
+                                std::max(TileSize, nextPow2(2 * tw)));
+    const int stepRows = height - th + 1, stepCols = width - tw + 1;
+    const int tileRows = (rows + stepRows - 1) / stepRows;
+    const int tileCols = (cols + stepCols - 1) / stepCols;
+    const size_t size = size_t(width) * height;
+    // Two channels are correlated at a time: with the channels in the
+    // real and imaginary parts, the real part of the correlation is the
+    // sum of the correlations of the two channels.
+    const int numPairs = (channels + 1) / 2;
+    std::vector<std::vector<Complex>> tmplSpecs(numPairs);
+    for (int pair = 0; (pair < numPairs); pair++) {
+        const int first = 2 * pair;
+        const int second = (first + 1 < channels) ? (first + 1) : -1;
+        tmplSpecs[pair].resize(size);
+        pack(tmpl, 0, 0, first, second, width, height, tmplSpecs[pair]);
+        transform2D(tmplSpecs[pair], width, height, th, false);
+    }
+    const double scale = 1.0 / size;
+    // With several tiles, each thread transforms whole tiles. Otherwise
+    // the rows and columns of the single tile are transformed in
+    // parallel.
+#pragma omp parallel if(tileRows * tileCols > 1)
+    {
+        std::vector<Complex> sum(size), imgSpec(size);
+#pragma omp for schedule(dynamic)
+        for (int tile = 0; tile < tileRows * tileCols; tile++) {
+            const int row0 = (tile / tileCols) * stepRows;
+            const int col0 = (tile % tileCols) * stepCols;
+            std::fill(sum.begin(), sum.end(), Complex());
+            for (int pair = 0; (pair < numPairs); pair++) {
+                const int first = 2 * pair;
+                const int second = (first + 1 < channels) ? (first + 1) : -1;
+                pack(img, row0, col0, first, second, width, height, imgSpec);
+                transform2D(imgSpec, width, height,
+                            std::min(height, img.getHeight() - row0), false);
+                const std::vector<Complex>& tmplSpec = tmplSpecs[pair];
+                for (size_t i = 0; (i < size); i++) {
+                    sum[i] += mulConj(imgSpec[i], tmplSpec[i]);
+                }
+            }
+            transform2D(sum, width, height, height, true);
+            const int numRows = std::min(stepRows, rows - row0);
+            const int numCols = std::min(stepCols, cols - col0);
+            for (int row = 0; (row < numRows); row++) {
+                const Complex* corr = &sum[size_t(row) * width];
+                double* out = &ssd[size_t(row0 + row) * cols + col0];
+                for (int col = 0; (col < numCols); col++) {
+                    out[col] -= 2 * std::llround(corr[col].real() * scale);
+                }
+            }
+        }
+    }
+}
+
+SSDMap::Mode
+SSDMap::toMode(const std::string& name) {
+    if (name == "off") {
+        return Off;
+    } else if (name == "auto") {
+        return Auto;
+    } else if (name == "on") {
+        return On;
+    }
+    throw std::invalid_argument("Invalid FFT mode: " + name);
+}
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef SSD_MAP_H
+#define SSD_MAP_H
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "PNG.h"
+
+/**
+   The sum of squared differences (SSD) between a sub-image and every
+   window of an image, computed for all the windows at once:
+
+       SSD = sum(I^2) - 2 * sum(I * T) + sum(T^2)
+
+   The sums of squared image values are obtained from sliding column
+   sums, and the cross-correlation sum(I * T) of all the windows from
+   FFTs of the sub-image and overlapping tiles of the image
+   (overlap-save). The cost is thereby independent of the size of the
+   sub-image, and the memory for the FFTs is bounded by the tile size
+   (per thread). The correlations are rounded to the nearest integer,
+   so the SSDs are exactly those computed by scoring each window
+   directly.
+*/
+class SSDMap {
+public:
+    /** Sub-images with fewer pixels than this are scored directly, as
+        that is cheaper than the FFTs.
+    */
+    static constexpr int MinPixels = 256;
+
+    /** The minimum height and width of the FFTs of the tiles. Tiles are
+        larger for large sub-images, but never larger than the image.
+    */
+    static constexpr int TileSize = 512;
+
+    /** In the Auto mode, SSD maps that need more memory than this (8
+        bytes per window) are not used, and windows are scored directly.
+    */
+    static constexpr size_t MaxAutoBytes = size_t(4) << 30;
+
+    /** When SSD maps are used: never, for sub-images with at least
+        MinPixels pixels (if the map needs at most MaxAutoBytes), or for
+        all sub-images.
+    */
+    enum Mode { Off, Auto, On };
+
+    /** Determine if an SSD map is to be used for a sub-image.
+
+        \param[in] mode The mode specified by the user.
+
+        \param[in] img The image being searched.
+
+        \param[in] tmpl The sub-image being searched for.
+    */
+    static bool isUsed(const Mode mode, const PNG& img, const PNG& tmpl) {
+        const size_t windows =
+            size_t(std::max(0, img.getWidth() - tmpl.getWidth() + 1)) *
+            std::max(0, img.getHeight() - tmpl.getHeight() + 1);
+        return (mode == On) || ((mode == Auto) &&
+            (tmpl.getWidth() * tmpl.getHeight() >= MinPixels) &&
+            (windows * sizeof(double) <= MaxAutoBytes));
+    }
+
+    /** Convert the name of a mode ("off", "auto", or "on").
+
+        \throws std::invalid_argument If the name is not valid.
+    */
+    static Mode toMode(const std::string& name);
+
+    /** Compute the SSD of all the windows of the image.
+
+        \param[in] img The image being searched.
+
+        \param[in] tmpl The sub-image being searched for.
+
+        \param[in] channels The number of channels compared (1 or 3).
+    */
+    SSDMap(const PNG& img, const PNG& tmpl, int channels);
+
+    /** The SSD of the window at the given location. */
+    double at(const int row, const int col) const {
+        return ssd[size_t(row) * cols + col];
+    }
+
+    /** The number of rows and columns of windows in the map. */
+    int getRows() const { return rows; }
+    int getCols() const { return cols; }
+
+private:
+    /** Compute the sum of squared image values of each window. */
+    void addSquares(const PNG& img, const PNG& tmpl, int channels);
+
+    /** Subtract twice the cross-correlation of each window with the
+        sub-image, computed with FFTs of overlapping tiles of the image.
+    */
+    void subtractCorrelation(const PNG& img, const PNG& tmpl, int channels);
+
+    /** The number of rows and columns of windows. */
+    int rows, cols;
+
+    /** The SSD of each window (in row-major order). */
+    std::vector<double> ssd;
+};
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef SCALE_SEARCH_CPP
+#define SCALE_SEARCH_CPP
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <functional>
+#include "ScaleSearch.h"
+
+namespace {
+    /** Windows are not screened on levels at which the smaller
+        dimension of the resized mask would be less than this value,
+        as such masks are too coarse to be discriminating.
+    */
+    constexpr double MinCoarseSize = 12;
+}
+
+ScaleSearch::ScaleSearch(const PNG& origMask, double scale, bool isMask,
+                         ScoreMetric metric, int channels, int matchPercent,
+                         int tolerance, int maxLevel, int slack,
+                         int stripWidth) :
+    scale(scale) {
+    // Nearest-neighbor sampling retains the black/white pixels of masks.
+    mask = (scale == 1) ? origMask :
+        ImagePyramid::resample(origMask, scale, isMask);
+    kernel = std::make_unique<SearchKernel>(mask, isMask, metric, channels,
+                                            matchPercent, tolerance,
+                                            stripWidth);
+    // Use the coarsest permitted level on which the mask is still
+    // sufficiently large.
+    const double minSize = std::min(mask.getWidth(), mask.getHeight());
+    while ((level < maxLevel) && (minSize / (2 << level) >= MinCoarseSize)) {
+        level++;
+    }
+    if (level > 0) {
+        coarseMask = ImagePyramid::resample(origMask, scale / (1 << level),
+                                            isMask);
+        coarseKernel = std::make_unique<SearchKernel>(coarseMask, isMask,
+            metric, channels, std::max(0, matchPercent - slack), tolerance,
+            stripWidth);
+    }
+}
+
+void
+ScaleSearch::prepare(const ImagePyramid& pyramid) {
+    if (level == 0) {
+        return;
+    }
+    const PNG& img = pyramid.getLevel(level);
+    const int maxRow = img.getHeight() - coarseMask.getHeight();
+    const int maxCol = img.getWidth()  - coarseMask.getWidth();
+    if ((maxRow < 0) || (maxCol < 0)) {
+        level = 0;  // Rounding leaves no room on the coarse level
+        return;
+    }
+    passRows = maxRow + 1;
+    passCols = maxCol + 1;
+    std::vector<unsigned char> hits(passRows * passCols);
+#pragma omp parallel for schedule(dynamic)
+    for (int row = 0; (row <= maxRow); row++) {
+        coarseKernel->matchRow(img, row, passCols, &hits[row * passCols]);
+    }
+    // A full-resolution window lies between coarse windows. So dilate
+    // the hits to include the neighboring windows.
+    const auto isHit = [&](const int row, const int col) {
+        return (row >= 0) && (row <= maxRow) && (col >= 0) &&
+            (col <= maxCol) && hits[row * passCols + col];
+    };
+    passed.resize(hits.size());
+#pragma omp parallel for
+    for (int row = 0; (row <= maxRow); row++) {
+        for (int col = 0; (col <= maxCol); col++) {
+            bool pass = false;
+            for (int dr = -1; (dr <= 1); dr++) {
+                for (int dc = -1; (dc <= 1); dc++) {
+                    pass = pass || isHit(row + dr, col + dc);
+                }
+            }
+            passed[row * passCols + col] = pass;
+        }
+    }
+}
+
+std::vector<double>
+ScaleSearch::parseScales(const std::string& spec) {
+    std::vector<double> scales;
+    std::istringstream is(spec);
+    double value;
+    char sep = ',';
+    if (spec.find(':') != std::string::npos) {
+        double min, max, step;
+        char colon;
+        if (!(is >> min >> colon >> max >> colon >> step) || (step <= 0)) {
+            throw std::invalid_argument("Invalid range of scales: " + spec);
+        }
+        // Allow for round-off in the last step.
+        for (int i = 0; (min + i * step <= max + step * 1e-6); i++) {
+            scales.push_back(min + i * step);
+        }
+    } else {
+        while ((sep == ',') && (is >> value)) {
+            scales.push_back(value);
+            is >> sep;
+        }
+    }
+    if (scales.empty() || (*std::min_element(scales.begin(), scales.end())
+                           <= 0)) {
+        throw std::invalid_argument("Invalid list of scales: " + spec);
+    }
+    // Larger scales are searched first, so that a larger match takes
+    // precedence over smaller ones it overlaps.
+    std::sort(scales.begin(), scales.end(), std::greater<double>());
+    scales.erase(std::unique(scales.begin(), scales.end()), scales.end());
+    return scales;
+}
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef SCALE_SEARCH_H
+#define SCALE_SEARCH_H
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include "PNG.h"
+#include "SearchKernel.h"
+#include "ImagePyramid.h"
+
+/**
+   The search for one scaled version of the mask (or sub-image) in a
+   multi-scale search.
+
+   To reduce the number of full-resolution windows scored, windows are
+   first screened on a coarser level of the image pyramid: the mask is
+   resampled to the resolution of that level and scored with a lowered
+   match percentage. Only full-resolution windows near a coarse window
+   that passes this screen are scored with the regular kernel.
+*/
+class ScaleSearch {
+public:
+    /** Setup the search for the mask at the given scale.
+
+        \param[in] mask The mask (or sub-image) at its original size.
+
+        \param[in] scale The factor by which the mask is resized.
+
+        \param[in] isMask If true, mask is a black-and-white mask.
+
+        \param[in] metric The metric used to score windows.
+
+        \param[in] channels The number of channels compared (1 or 3).
+
+        \param[in] matchPercent The percentage used to compute the
+        match threshold.
+
+        \param[in] tolerance The tolerance used by the metric.
+
+        \param[in] maxLevel The highest pyramid level on which windows
+        may be screened. Zero disables screening.
+
+        \param[in] slack The amount by which matchPercent is lowered
+        when screening windows on a coarse level.
+
+        \param[in] stripWidth The number of adjacent windows scored
+        together by the kernels (0, 8, or 16).
+    */
+    ScaleSearch(const PNG& mask, double scale, bool isMask,
+                ScoreMetric metric, int channels, int matchPercent,
+                int tolerance, int maxLevel = 0, int slack = 0,
+                int stripWidth = 0);
+
+    /** Screen all the windows on the coarse level of the pyramid.
+        This method must be called (after the necessary levels of the
+        pyramid have been built) before screen() is used.
+
+        \param[in] pyramid The pyramid of the image being searched.
+    */
+    void prepare(const ImagePyramid& pyramid);
+
+    /** Determine if the full-resolution window at the given location
+        passed the screening on the coarse level of the pyramid.
+    */
+    bool screen(const int row, const int col) const {
+        if (level == 0) {
+            return true;  // No screening
+        }
+        const int r = std::min(row >> level, passRows - 1);
+        const int c = std::min(col >> level, passCols - 1);
+        return (r >= 0) && (c >= 0) && passed[r * passCols + c];
+    }
+
+    /** The pyramid level on which windows are screened (0 if none). */
+    int getLevel() const { return level; }
+
+    /** The scale factor applied to the mask. */
+    double getScale() const { return scale; }
+
+    /** The resized mask. */
+    const PNG& getMask() const { return mask; }
+
+    /** The kernel used to score full-resolution windows. */
+    const SearchKernel& getKernel() const { return *kernel; }
+
+    /** Enable the cascade prefilter of the full-resolution kernel. See
+        SearchKernel::setCascade().
+    */
+    void setCascade(int samples, int margin) {
+        kernel->setCascade(samples, margin);
+    }
+
+    /** Use the SSD of every window in the full-resolution kernel. See
+        SearchKernel::setSSDMap().
+    */
+    void setSSDMap(std::shared_ptr<const SSDMap> map) {
+        kernel->setSSDMap(map);
+    }
+
+    /** Parse a list of scales, specified either as comma-separated
+        values ("0.5,1,2") or as a range ("min:max:step").
+
+        \return The scales, sorted from largest to smallest.
+
+        \throws std::invalid_argument If the list is not valid.
+    */
+    static std::vector<double> parseScales(const std::string& spec);
+
+private:
+    /** The scale factor applied to the mask. */
+    const double scale;
+
+    /** The mask resized by the scale factor. */
+    PNG mask;
+
+    /** The kernel used to score full-resolution windows. */
+    std::unique_ptr<SearchKernel> kernel;
+
+    /** The pyramid level on which windows are screened (0 if none). */
+    int level = 0;
+
+    /** The mask resized to the resolution of the coarse level. */
+    PNG coarseMask;
+
+    /** The kernel (with a lowered threshold) used for screening. */
+    std::unique_ptr<SearchKernel> coarseKernel;
+
+    /** Flags (one per coarse window, dilated by one window in each
+        direction) to indicate the windows that passed the screening.
+    */
+    std::vector<unsigned char> passed;
+
+    /** The dimensions of the passed array. */
+    int passRows = 0, passCols = 0;
+};
+
+#endif
@@ -0,0 +1,585 @@
+#ifndef SCORING_POLICIES_H
+#define SCORING_POLICIES_H
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <limits>
+#include <cstring>
+#include <algorithm>
+#include "SearchKernel.h"
+
+// The strip kernels extract the channels of RGBA pixels loaded as
+// 32-bit words, which assumes a little-endian byte order.
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "Strip kernels require a little-endian byte order");
+
+/**
+   The reference colors used to score a window in mask mode. The
+   background is the average color of the image pixels under the
+   black pixels of the mask and the foreground is the average color
+   of the image pixels under the remaining pixels of the mask.
+*/
+struct WindowReference {
+    unsigned char bg[4] = {0, 0, 0, 255};
+    unsigned char fg[4] = {0, 0, 0, 255};
+};
+
+/**
+   The reference colors of a strip of Width adjacent windows, stored
+   channel-by-channel so that the loops over the windows vectorize.
+*/
+template<int Width>
+struct StripReference {
+    explicit StripReference(const WindowReference (&ref)[Width]) {
+        for (int c = 0; (c < 3); c++) {
+            for (int j = 0; (j < Width); j++) {
+                bg[c][j] = ref[j].bg[c];
+                fg[c][j] = ref[j].fg[c];
+            }
+        }
+    }
+    int bg[3][Width];
+    int fg[3][Width];
+};
+
+/** Obtain channel c of an RGBA pixel loaded as a 32-bit word. */
+inline int channel(const uint32_t pix, const int c) {
+    return (pix >> (8 * c)) & 0xff;
+}
+
+/**
+   The scoring policies used by the search kernels. Each policy
+   provides:
+
+   - NeedsReference: true if the policy uses the WindowReference in
+     mask mode (and hence an additional pass over the window).
+
+   - Accum: the type used to accumulate per-pixel contributions.
+
+   - add<Channels, IsMask>(): accumulate the contribution of a single
+     pixel. These methods are written without branches so that the
+     compiler can vectorize the loops calling them.
+
+   - addStrip<Channels, IsMask, Width>(): accumulate the contributions
+     of a single template pixel to Width adjacent windows, given the
+     Width image pixels under it (one per window).
+
+   - finish(): convert the accumulated value (and the reference colors
+     of the window) into a score. Larger scores are better.
+
+   - threshold(): the score a window must exceed to be a match.
+*/
+
+/**
+   The original scoring rule: each pixel contributes +1 if it agrees
+   with the template and -1 otherwise. In mask mode a pixel under a
+   black mask pixel agrees if all its channels are within tolerance
+   of the background while a pixel under a white mask pixel agrees if
+   it is not.  Without a mask, a pixel agrees if all its channels are
+   within tolerance of the corresponding sub-image pixel.
+*/
+struct ToleranceScore {
+    static constexpr bool NeedsReference = true;
+    using Accum = int;
+
+    template<int Channels, bool IsMask>
+    static inline void add(Accum& acc, const unsigned char* pix,
+                           const unsigned char* tmplPix, const int black,
+                           const WindowReference& ref, const int tolerance) {
+        const unsigned char* expected = IsMask ? ref.bg : tmplPix;
+        int inTol = 1;
+        for (int c = 0; (c < Channels); c++) {
+            inTol &= (std::abs(pix[c] - expected[c]) < tolerance);
+        }
+        acc += IsMask ? (1 - 2 * (inTol ^ black)) : (2 * inTol - 1);
+    }
+
+    template<int Channels, bool IsMask, int Width>
+    static inline void addStrip(Accum (&acc)[Width], const uint32_t* pix,
+                                const unsigned char* tmplPix, const int black,
+                                const StripReference<Width>& ref,
+                                const int tolerance) {
+        for (int j = 0; (j < Width); j++) {
+            int inTol = 1;
+            for (int c = 0; (c < Channels); c++) {
+                const int expected = IsMask ? ref.bg[c][j] : tmplPix[c];
+                inTol &= (std::abs(channel(pix[j], c) - expected) < tolerance);
+            }
+            acc[j] += IsMask ? (1 - 2 * (inTol ^ black)) : (2 * inTol - 1);
+        }
+    }
+
+    static inline float finish(const Accum acc, const SearchTemplate&,
+                               const WindowReference&, const int) {
+        return acc;
+    }
+
+    static float threshold(const int pixels, const int, const int percent,
+                           const int) {
+        // Same integer arithmetic as mask.getBufferSize() * percent / 400
+        return (pixels * 4 * percent) / 400;
+    }
+};
+
+/**
+   Sum of absolute differences (SAD) over the channels. In mask mode
+   the window is compared to a two-tone image with the background color
+   under black mask pixels and the foreground color elsewhere. Since a
+   flat window fits such a two-tone image perfectly, the background and
+   foreground must differ by at least the tolerance (in some channel).
+   The score is the negated SAD. A window matches if the mean absolute
+   difference per channel is less than 255 * (100 - percent) / 100, that
+   is, if the window is percent similar to the template.
+*/
+struct SADScore {
+    static constexpr bool NeedsReference = true;
+    using Accum = int64_t;
+
+    template<int Channels, bool IsMask>
+    static inline void add(Accum& acc, const unsigned char* pix,
+                           const unsigned char* tmplPix, const int black,
+                           const WindowReference& ref, const int) {
+        int sad = 0;
+        for (int c = 0; (c < Channels); c++) {
+            const int expected = IsMask ?
+                (black ? ref.bg[c] : ref.fg[c]) : tmplPix[c];
+            sad += std::abs(pix[c] - expected);
+        }
+        acc += sad;
+    }
+
+    template<int Channels, bool IsMask, int Width>
+    static inline void addStrip(Accum (&acc)[Width], const uint32_t* pix,
+                                const unsigned char* tmplPix, const int black,
+                                const StripReference<Width>& ref, const int) {
+        for (int j = 0; (j < Width); j++) {
+            int sad = 0;
+            for (int c = 0; (c < Channels); c++) {
+                const int expected = IsMask ?
+                    (black ? ref.bg[c][j] : ref.fg[c][j]) : tmplPix[c];
+                sad += std::abs(channel(pix[j], c) - expected);
+            }
+            acc[j] += sad;
+        }
+    }
+
+    static inline float finish(const Accum acc, const SearchTemplate& tmpl,
+                               const WindowReference& ref,
+                               const int tolerance) {
+        if (tmpl.isMask) {
+            int contrast = 0;
+            for (int c = 0; (c < 3); c++) {
+                contrast = std::max(contrast, std::abs(ref.fg[c] - ref.bg[c]));
+            }
+            if (contrast < tolerance) {
+                return -std::numeric_limits<float>::infinity();
+            }
+        }
+        return -float(acc);
+    }
+
+    static float threshold(const int pixels, const int channels,
+                           const int percent, const int) {
+        return -(float(pixels) * channels * 255 * (100 - percent) / 100);
+    }
+};
+
+/**
+   Sum of squared differences (SSD) over the channels. The template is
+   the same as for SADScore (including the contrast check in mask mode).
+   The score is the negated SSD. A window matches if the root mean
+   square difference per channel is less than 255 * (100 - percent) /
+   100. In sub-image mode, the SSD of all the windows can also be
+   computed with FFTs (see SSDMap).
+*/
+struct SSDScore {
+    static constexpr bool NeedsReference = true;
+    using Accum = int64_t;
+
+    template<int Channels, bool IsMask>
+    static inline void add(Accum& acc, const unsigned char* pix,
+                           const unsigned char* tmplPix, const int black,
+                           const WindowReference& ref, const int) {
+        int ssd = 0;
+        for (int c = 0; (c < Channels); c++) {
+            const int expected = IsMask ?
+                (black ? ref.bg[c] : ref.fg[c]) : tmplPix[c];
+            const int diff = pix[c] - expected;
+            ssd += diff * diff;
+        }
+        acc += ssd;
+    }
+
+    template<int Channels, bool IsMask, int Width>
+    static inline void addStrip(Accum (&acc)[Width], const uint32_t* pix,
+                                const unsigned char* tmplPix, const int black,
+                                const StripReference<Width>& ref, const int) {
+        for (int j = 0; (j < Width); j++) {
+            int ssd = 0;
+            for (int c = 0; (c < Channels); c++) {
+                const int expected = IsMask ?
+                    (black ? ref.bg[c][j] : ref.fg[c][j]) : tmplPix[c];
+                const int diff = channel(pix[j], c) - expected;
+                ssd += diff * diff;
+            }
+            acc[j] += ssd;
+        }
+    }
+
+    static inline float finish(const Accum acc, const SearchTemplate& tmpl,
+                               const WindowReference& ref,
+                               const int tolerance) {
+        // Same contrast check as SADScore
+        return std::isinf(SADScore::finish(0, tmpl, ref, tolerance)) ?
+            -std::numeric_limits<float>::infinity() : -float(acc);
+    }
+
+    static float threshold(const int pixels, const int channels,
+                           const int percent, const int) {
+        const float diff = 255.0f * (100 - percent) / 100;
+        return -(float(pixels) * channels * diff * diff);
+    }
+};
+
+/**
+   Normalized cross-correlation (NCC) of pixel intensities (sum of the
+   channels). In mask mode the window is correlated with the mask
+   itself (white = 1, black = 0) and the absolute value is used, as
+   the pattern may be lighter or darker than the background. A window
+   matches if its correlation exceeds percent / 100.
+*/
+struct NCCScore {
+    static constexpr bool NeedsReference = false;
+
+    struct Accum {
+        int64_t sumX = 0, sumXX = 0, sumXT = 0;
+    };
+
+    template<int Channels, bool IsMask>
+    static inline void add(Accum& acc, const unsigned char* pix,
+                           const unsigned char* tmplPix, const int black,
+                           const WindowReference&, const int) {
+        int x = 0, t = 0;
+        for (int c = 0; (c < Channels); c++) {
+            x += pix[c];
+            t += tmplPix[c];
+        }
+        t = IsMask ? (1 - black) : t;
+        acc.sumX  += x;
+        acc.sumXX += x * x;
+        acc.sumXT += x * t;
+    }
+
+    template<int Channels, bool IsMask, int Width>
+    static inline void addStrip(Accum (&acc)[Width], const uint32_t* pix,
+                                const unsigned char* tmplPix, const int black,
+                                const StripReference<Width>&, const int) {
+        int t = 0;
+        for (int c = 0; (c < Channels); c++) {
+            t += tmplPix[c];
+        }
+        t = IsMask ? (1 - black) : t;
+        for (int j = 0; (j < Width); j++) {
+            int x = 0;
+            for (int c = 0; (c < Channels); c++) {
+                x += channel(pix[j], c);
+            }
+            acc[j].sumX  += x;
+            acc[j].sumXX += x * x;
+            acc[j].sumXT += x * t;
+        }
+    }
+
+    static inline float finish(const Accum& acc, const SearchTemplate& tmpl,
+                               const WindowReference&, const int) {
+        const double n    = tmpl.width * tmpl.height;
+        const double varX = acc.sumXX - double(acc.sumX) * acc.sumX / n;
+        const double cov  = acc.sumXT - double(acc.sumX) * tmpl.sumT / n;
+        if ((varX <= 0) || (tmpl.varT <= 0)) {
+            return 0;  // A flat window (or template) does not correlate
+        }
+        const double ncc = cov / std::sqrt(varX * tmpl.varT);
+        return tmpl.isMask ? std::fabs(ncc) : ncc;
+    }
+
+    static float threshold(const int, const int, const int percent,
+                           const int) {
+        return percent / 100.0f;
+    }
+};
+
+/**
+   Compute the average background (and foreground) color of a window
+   in mask mode.
+
+   \param[in] img Pointer to the top-left pixel of the window.
+
+   \param[in] stride The number of bytes between rows of the image.
+
+   \param[in] tmpl The mask for which the window is being scored.
+
+   \return The background and foreground colors of the window.
+*/
+template<int Channels>
+WindowReference computeReference(const unsigned char* img, const int stride,
+                                 const SearchTemplate& tmpl) {
+    int bgSum[Channels] = {}, fgSum[Channels] = {}, count = 0;
+    for (int row = 0; (row < tmpl.height); row++) {
+        const unsigned char* pix   = img + row * stride;
+        const unsigned char* black = &tmpl.isBlack[row * tmpl.width];
+        for (int col = 0; (col < tmpl.width); col++, pix += 4) {
+            for (int c = 0; (c < Channels); c++) {
+                bgSum[c] += pix[c] * black[col];
+                fgSum[c] += pix[c] * (1 - black[col]);
+            }
+            count += black[col];
+        }
+    }
+    WindowReference ref;
+    const int fgCount = tmpl.width * tmpl.height - count;
+    for (int c = 0; (c < 3); c++) {
+        // Single-channel (gray) images replicate the first channel.
+        const int ch = (c < Channels) ? c : 0;
+        ref.bg[c] = (count   > 0) ? (bgSum[ch] / count)   : 0;
+        ref.fg[c] = (fgCount > 0) ? (fgSum[ch] / fgCount) : 0;
+    }
+    return ref;
+}
+
+/**
+   Compute the reference colors of Width horizontally adjacent windows
+   in mask mode. This is the blocked version of computeReference() and
+   yields identical results for each window.
+
+   \param[in] img Pointer to the top-left pixel of the first window.
+
+   \param[in] stride The number of bytes between rows of the image.
+
+   \param[in] tmpl The mask for which the windows are being scored.
+
+   \param[out] ref The reference colors of the Width windows.
+*/
+template<int Channels, int Width>
+void computeStripReference(const unsigned char* img, const int stride,
+                           const SearchTemplate& tmpl,
+                           WindowReference (&ref)[Width]) {
+    int bgSum[Channels][Width] = {}, allSum[Channels][Width] = {}, count = 0;
+    for (int row = 0; (row < tmpl.height); row++) {
+        const unsigned char* pix   = img + row * stride;
+        const unsigned char* black = &tmpl.isBlack[row * tmpl.width];
+        for (int col = 0; (col < tmpl.width); col++, pix += 4) {
+            uint32_t strip[Width];
+            std::memcpy(strip, pix, sizeof(strip));
+            for (int c = 0; (c < Channels); c++) {
+                for (int j = 0; (j < Width); j++) {
+                    bgSum[c][j]  += channel(strip[j], c) * black[col];
+                    allSum[c][j] += channel(strip[j], c);
+                }
+            }
+            count += black[col];
+        }
+    }
+    const int fgCount = tmpl.width * tmpl.height - count;
+    for (int j = 0; (j < Width); j++) {
+        for (int c = 0; (c < 3); c++) {
+            // Single-channel (gray) images replicate the first channel.
+            const int ch = (c < Channels) ? c : 0;
+            ref[j].bg[c] = (count > 0) ? (bgSum[ch][j] / count) : 0;
+            ref[j].fg[c] = (fgCount > 0) ?
+                ((allSum[ch][j] - bgSum[ch][j]) / fgCount) : 0;
+        }
+    }
+}
+
+/**
+   The generic search kernel that scores a single window of the image
+   against the template. All the parameters that influence the inner
+   loop are template parameters so that each combination compiles to
+   a branch-free, fully inlined loop.
+
+   \tparam Policy The scoring policy (ToleranceScore, SADScore, etc.)
+
+   \tparam Channels The number of color channels compared (1 or 3).
+
+   \tparam IsMask If true the template is a black-and-white mask.
+   Otherwise the template is a sub-image whose colors are compared.
+
+   \param[in] img Pointer to the top-left pixel of the window.
+
+   \param[in] stride The number of bytes between rows of the image.
+
+   \param[in] tmpl The template against which the window is scored.
+
+   \param[in] tolerance The tolerance used by some policies.
+
+   \param[out] bgPix If not NULL, the background color of the window is
+   stored here (for diagnostics).
+
+   \return The score for the window.
+*/
+template<class Policy, int Channels, bool IsMask>
+float scoreWindow(const unsigned char* img, const int stride,
+                  const SearchTemplate& tmpl, const int tolerance,
+                  Pixel* bgPix) {
+    WindowReference ref;
+    if (IsMask && Policy::NeedsReference) {
+        ref = computeReference<Channels>(img, stride, tmpl);
+    }
+    if (bgPix != NULL) {
+        *bgPix = {.color = {ref.bg[0], ref.bg[1], ref.bg[2], ref.bg[3]}};
+    }
+    typename Policy::Accum acc{};
+    for (int row = 0; (row < tmpl.height); row++) {
+        const unsigned char* pix   = img + row * stride;
+        const unsigned char* tpix  = tmpl.pixels + row * tmpl.width * 4;
+        const unsigned char* black = &tmpl.isBlack[row * tmpl.width];
+        for (int col = 0; (col < tmpl.width); col++) {
+            Policy::template add<Channels, IsMask>(acc, pix + col * 4,
+                tpix + col * 4, black[col], ref, tolerance);
+        }
+    }
+    return Policy::finish(acc, tmpl, ref, tolerance);
+}
+
+/**
+   Score a strip of Width horizontally adjacent windows with the
+   tolerance metric (ToleranceScore) for several tolerances in one
+   pass. A pixel is within a tolerance if the maximum difference over
+   its channels is below the tolerance, so the per-pixel work beyond
+   computing that difference is one comparison per tolerance. The
+   scores are identical to those computed by scoreWindow() with
+   ToleranceScore for each tolerance. Width may be 1.
+
+   \param[in] img Pointer to the top-left pixel of the first window.
+
+   \param[in] stride The number of bytes between rows of the image.
+
+   \param[in] tmpl The template against which the windows are scored.
+
+   \param[in] tolerances The tolerances for which windows are scored.
+
+   \param[in] numTolerances The number of tolerances.
+
+   \param[out] scores The scores of the windows. Entry k * Width + j
+   is the score of the j'th window for the k'th tolerance.
+*/
+template<int Channels, bool IsMask, int Width>
+void scoreStripTolerances(const unsigned char* img, const int stride,
+                          const SearchTemplate& tmpl, const int* tolerances,
+                          const int numTolerances, int* scores) {
+    WindowReference refs[Width];
+    if (IsMask) {
+        computeStripReference<Channels, Width>(img, stride, tmpl, refs);
+    }
+    const StripReference<Width> ref(refs);
+    std::fill_n(scores, numTolerances * Width, 0);
+    for (int row = 0; (row < tmpl.height); row++) {
+        const unsigned char* pix   = img + row * stride;
+        const unsigned char* tpix  = tmpl.pixels + row * tmpl.width * 4;
+        const unsigned char* black = &tmpl.isBlack[row * tmpl.width];
+        for (int col = 0; (col < tmpl.width); col++, pix += 4) {
+            uint32_t strip[Width];
+            std::memcpy(strip, pix, sizeof(strip));
+            int diff[Width];
+            for (int j = 0; (j < Width); j++) {
+                diff[j] = 0;
+                for (int c = 0; (c < Channels); c++) {
+                    const int expected = IsMask ? ref.bg[c][j] :
+                        tpix[col * 4 + c];
+                    diff[j] = std::max(diff[j],
+                        std::abs(channel(strip[j], c) - expected));
+                }
+            }
+            // The amount added if the pixel is within the tolerance.
+            // In mask mode, only black pixels are expected to be within
+            // the tolerance of the background.
+            const int inc = (IsMask && !black[col]) ? -1 : 1;
+            for (int k = 0; (k < numTolerances); k++) {
+                int* acc = scores + k * Width;
+                const int tolerance = tolerances[k];
+                for (int j = 0; (j < Width); j++) {
+                    acc[j] += (diff[j] < tolerance) ? inc : -inc;
+                }
+            }
+        }
+    }
+}
+
+/**
+   The register-blocked search kernel that scores a strip of Width
+   horizontally adjacent windows in one pass over the template. For
+   each template pixel, the Width image pixels under it (one for each
+   window) are contiguous in memory and the Width partial scores are
+   held in registers. Consequently, each image pixel is loaded once
+   per strip rather than once per window, and the loop over the
+   windows vectorizes. The scores are identical to those computed by
+   scoreWindow().
+
+   \tparam Width The number of adjacent windows scored together.
+
+   \param[in] img Pointer to the top-left pixel of the first window.
+
+   \param[in] stride The number of bytes between rows of the image.
+
+   \param[in] tmpl The template against which the windows are scored.
+
+   \param[in] tolerance The tolerance used by some policies.
+
+   \param[out] scores The scores of the Width windows.
+
+   \param[out] bgPix If not NULL, the background colors of the Width
+   windows are stored here (for diagnostics).
+*/
+template<class Policy, int Channels, bool IsMask, int Width>
+void scoreStrip(const unsigned char* img, const int stride,
+                const SearchTemplate& tmpl, const int tolerance,
+                float* scores, Pixel* bgPix) {
+    WindowReference ref[Width];
+    if (IsMask && Policy::NeedsReference) {
+        computeStripReference<Channels, Width>(img, stride, tmpl, ref);
+    }
+    const StripReference<Width> stripRef(ref);
+    typename Policy::Accum acc[Width]{};
+    for (int row = 0; (row < tmpl.height); row++) {
+        const unsigned char* pix   = img + row * stride;
+        const unsigned char* tpix  = tmpl.pixels + row * tmpl.width * 4;
+        const unsigned char* black = &tmpl.isBlack[row * tmpl.width];
+        for (int col = 0; (col < tmpl.width); col++, pix += 4) {
+            // The Width image pixels under this template pixel.
+            uint32_t strip[Width];
+            std::memcpy(strip, pix, sizeof(strip));
+            Policy::template addStrip<Channels, IsMask, Width>(acc, strip,
+                tpix + col * 4, black[col], stripRef, tolerance);
+        }
+    }
+    for (int j = 0; (j < Width); j++) {
+        scores[j] = Policy::finish(acc[j], tmpl, ref[j], tolerance);
+        if (bgPix != NULL) {
+            bgPix[j] = {.color = {ref[j].bg[0], ref[j].bg[1], ref[j].bg[2],
+                                  ref[j].bg[3]}};
+        }
+    }
+}
+
+#endif
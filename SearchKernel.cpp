@@ -0,0 +1,323 @@
+#ifndef SEARCH_KERNEL_CPP
+#define SEARCH_KERNEL_CPP
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <omp.h>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include "SearchKernel.h"
+#include "ScoringPolicies.h"
+
+namespace {
+    /** Helper to select the kernel for a given policy. */
+    template<class Policy>
+    WindowScorer selectScorer(const int channels, const bool isMask) {
+        if (channels == 1) {
+            return isMask ? scoreWindow<Policy, 1, true> :
+                scoreWindow<Policy, 1, false>;
+        }
+        return isMask ? scoreWindow<Policy, 3, true> :
+            scoreWindow<Policy, 3, false>;
+    }
+
+    /** Helper to select the strip kernel for a given policy and width. */
+    template<class Policy, int Width>
+    StripScorer selectStripScorer(const int channels, const bool isMask) {
+        if (channels == 1) {
+            return isMask ? scoreStrip<Policy, 1, true, Width> :
+                scoreStrip<Policy, 1, false, Width>;
+        }
+        return isMask ? scoreStrip<Policy, 3, true, Width> :
+            scoreStrip<Policy, 3, false, Width>;
+    }
+
+    /** Helper to select the strip kernel for a given policy. */
+    template<class Policy>
+    StripScorer selectStripScorer(const int width, const int channels,
+                                  const bool isMask) {
+        switch (width) {
+        case 8:  return selectStripScorer<Policy, 8>(channels, isMask);
+        case 16: return selectStripScorer<Policy, 16>(channels, isMask);
+        default: return NULL;
+        }
+    }
+}
+
+SearchTemplate::SearchTemplate(const PNG& img, bool isMask, int channels) :
+    width(img.getWidth()), height(img.getHeight()), isMask(isMask),
+    pixels(img.getPixels()), isBlack(width * height), sumT(0), varT(0) {
+    const Pixel Black{ .rgba = 0xff'00'00'00U };
+    double sumSq = 0;
+    for (int row = 0, idx = 0; (row < height); row++) {
+        for (int col = 0; (col < width); col++, idx++) {
+            const Pixel pix = img.getPixel(row, col);
+            isBlack[idx] = (pix.rgba == Black.rgba);
+            // The values correlated against by NCCScore.
+            const int t = isMask ? (1 - isBlack[idx]) : ((channels == 1) ?
+                pix.color.red : (pix.color.red + pix.color.green +
+                                 pix.color.blue));
+            sumT  += t;
+            sumSq += double(t) * t;
+        }
+    }
+    varT = sumSq - sumT * sumT / (width * height);
+}
+
+SearchKernel::SearchKernel(const PNG& mask, bool isMask, ScoreMetric metric,
+                           int channels, int matchPercent, int tolerance,
+                           int stripWidth) :
+    tmpl(mask, isMask, channels), stripWidth(stripWidth),
+    tolerance(tolerance), metric(metric), channels(channels),
+    matchPercent(matchPercent) {
+    if ((channels != 1) && (channels != 3)) {
+        throw std::invalid_argument("Number of channels must be 1 or 3");
+    }
+    if ((stripWidth != 0) && (stripWidth != 8) && (stripWidth != 16)) {
+        throw std::invalid_argument("Strip width must be 0, 8, or 16");
+    }
+    const int pixels = mask.getWidth() * mask.getHeight();
+    switch (metric) {
+    case ScoreMetric::SAD:
+        scorer    = selectScorer<SADScore>(channels, isMask);
+        stripScorer = selectStripScorer<SADScore>(stripWidth, channels,
+                                                  isMask);
+        threshold = SADScore::threshold(pixels, channels, matchPercent,
+                                        tolerance);
+        break;
+    case ScoreMetric::SSD:
+        scorer    = selectScorer<SSDScore>(channels, isMask);
+        stripScorer = selectStripScorer<SSDScore>(stripWidth, channels,
+                                                  isMask);
+        threshold = SSDScore::threshold(pixels, channels, matchPercent,
+                                        tolerance);
+        break;
+    case ScoreMetric::NCC:
+        scorer    = selectScorer<NCCScore>(channels, isMask);
+        stripScorer = selectStripScorer<NCCScore>(stripWidth, channels,
+                                                  isMask);
+        threshold = NCCScore::threshold(pixels, channels, matchPercent,
+                                        tolerance);
+        break;
+    default:
+        scorer    = selectScorer<ToleranceScore>(channels, isMask);
+        stripScorer = selectStripScorer<ToleranceScore>(stripWidth, channels,
+                                                        isMask);
+        threshold = ToleranceScore::threshold(pixels, channels, matchPercent,
+                                              tolerance);
+    }
+}
+
+void
+SearchKernel::matchRow(const PNG& img, const int row, const int numCols,
+                       unsigned char* hits) const {
+    float scores[MaxStripWidth];
+    int col = 0;
+    for (; (stripWidth > 0) && (col + stripWidth <= numCols);
+         col += stripWidth) {
+        scoreStrip(img, row, col, scores);
+        for (int j = 0; (j < stripWidth); j++) {
+            hits[col + j] = isMatch(scores[j]);
+        }
+    }
+    for (; (col < numCols); col++) {
+        hits[col] = isMatch(score(img, row, col));
+    }
+}
+
+void
+SearchKernel::setCascade(int samples, int margin) {
+    const int pixels = tmpl.width * tmpl.height;
+    samples = std::min(samples, MaxCascadeSamples);
+    if (samples * 4 > pixels) {
+        cascade.reset();
+        return;  // The subset is not much smaller than the mask
+    }
+    // Separate the black pixels (only in mask mode) from the rest.
+    std::vector<int> blacks, others;
+    for (int i = 0; (i < pixels); i++) {
+        ((tmpl.isMask && tmpl.isBlack[i]) ? blacks : others).push_back(i);
+    }
+    // Proportional allocation, but with a few pixels of each color so
+    // that the background of the window can be estimated.
+    constexpr int MinPerColor = 4;
+    const auto atLeast = [&](int count, const std::vector<int>& color) {
+        return std::min<int>(color.size(), std::max(count,
+                             std::min<int>(MinPerColor, color.size())));
+    };
+    const int numBlack = atLeast(std::lround(double(samples) *
+                                             blacks.size() / pixels), blacks);
+    const int numOther = atLeast(samples - numBlack, others);
+    // Systematic sample (the middle pixel of each of n equal parts).
+    std::vector<int> subset;
+    const auto pick = [&subset](const std::vector<int>& color, const int n) {
+        for (int k = 0; (k < n); k++) {
+            subset.push_back(color[(2 * k + 1) * color.size() / (2 * n)]);
+        }
+    };
+    pick(blacks, numBlack);
+    pick(others, numOther);
+    std::sort(subset.begin(), subset.end());
+    // Create the subset as an image with a single column. The pixels of
+    // a window under the subset are gathered into the same layout, so
+    // that the regular kernels score windows on the subset.
+    cascadeMask.create(1, subset.size());
+    sampleRows.clear();
+    sampleCols.clear();
+    for (size_t i = 0; (i < subset.size()); i++) {
+        std::memcpy(cascadeMask.getPixels() + i * 4,
+                    tmpl.pixels + subset[i] * 4, 4);
+        sampleRows.push_back(subset[i] / tmpl.width);
+        sampleCols.push_back(subset[i] % tmpl.width);
+    }
+    cascade = std::make_unique<SearchKernel>(cascadeMask, tmpl.isMask,
+        metric, channels, std::max(0, matchPercent - margin), tolerance,
+        stripWidth);
+    numCounts = std::max(omp_get_max_threads(), omp_get_num_procs());
+    cascadeCounts = std::make_unique<CascadeCounts[]>(numCounts);
+}
+
+void
+SearchKernel::setSSDMap(std::shared_ptr<const SSDMap> map) {
+    if (tmpl.isMask) {
+        throw std::invalid_argument("SSD maps are only used for sub-images");
+    }
+    ssdMap    = map;
+    ssdScores = (metric == ScoreMetric::SSD);
+    // The most that a pixel that is within (or outside) the tolerance,
+    // or any pixel, adds to the SSD.
+    const int pixels = tmpl.width * tmpl.height;
+    const double maxDiff = 255.0 * 255 * channels;
+    const int inTol = std::min(std::max(tolerance - 1, 0), 255);
+    switch (metric) {
+    case ScoreMetric::SAD:
+        // Each channel adds at least diff^2 / 255 to the SAD. Allow for
+        // the rounding of the score to a float.
+        ssdLimit = 255 * (-threshold * (1 + 1e-6) + 1);
+        break;
+    case ScoreMetric::Tolerance: {
+        // A match needs more than (pixels + threshold) / 2 pixels within
+        // the tolerance. The SSD is largest if all others are outside.
+        const int need = std::max(0, int(std::floor((pixels + threshold) /
+                                                     2)) + 1);
+        ssdLimit = (need > pixels) || ((tolerance <= 0) && (need > 0)) ? -1 :
+            (need * double(inTol) * inTol * channels +
+             (pixels - need) * maxDiff);
+        break;
+    }
+    case ScoreMetric::SSD:
+        break;
+    default:
+        ssdMap.reset();  // Does not bound the NCC
+    }
+}
+
+bool
+SearchKernel::prefilter(const PNG& img, const int row, const int col) const {
+    if (!withinSSDLimit(row, col)) {
+        return false;
+    }
+    if (cascade == NULL) {
+        return true;
+    }
+    // Gather the pixels of the window under the subset of the mask.
+    unsigned char pixels[MaxCascadeSamples * 4];
+    const int numSamples = sampleRows.size();
+    const unsigned char* window = img.getPixels() +
+        (size_t(row) * img.getWidth() + col) * 4;
+    const int stride = img.getWidth() * 4;
+    for (int i = 0; (i < numSamples); i++) {
+        std::memcpy(pixels + i * 4,
+                    window + sampleRows[i] * stride + sampleCols[i] * 4, 4);
+    }
+    const bool passed = cascade->isMatch(cascade->scorer(pixels, 4,
+        cascade->tmpl, tolerance, NULL));
+    countCascade(1, passed);
+    return passed;
+}
+
+void
+SearchKernel::prefilterStrip(const PNG& img, const int row, const int col,
+                             unsigned char* passed) const {
+    int numTested = 0;
+    for (int j = 0; (j < stripWidth); j++) {
+        passed[j]  = withinSSDLimit(row, col + j);
+        numTested += passed[j];
+    }
+    if ((cascade == NULL) || (numTested == 0)) {
+        return;
+    }
+    // Gather the pixels of the windows under the subset of the mask, so
+    // that row i has the pixels under subset pixel i for each window.
+    unsigned char pixels[MaxCascadeSamples * MaxStripWidth * 4];
+    const int numSamples = sampleRows.size();
+    const unsigned char* window = img.getPixels() +
+        (size_t(row) * img.getWidth() + col) * 4;
+    const int stride = img.getWidth() * 4;
+    for (int i = 0; (i < numSamples); i++) {
+        std::memcpy(pixels + i * stripWidth * 4,
+                    window + sampleRows[i] * stride + sampleCols[i] * 4,
+                    stripWidth * 4);
+    }
+    float scores[MaxStripWidth];
+    cascade->stripScorer(pixels, stripWidth * 4, cascade->tmpl, tolerance,
+                         scores, NULL);
+    int numPassed = 0;
+    for (int j = 0; (j < stripWidth); j++) {
+        passed[j]  = passed[j] && cascade->isMatch(scores[j]);
+        numPassed += passed[j];
+    }
+    countCascade(numTested, numPassed);
+}
+
+void
+SearchKernel::countCascade(const int tested, const int passed) const {
+    CascadeCounts& counts = cascadeCounts[omp_get_thread_num() % numCounts];
+    counts.tested.fetch_add(tested, std::memory_order_relaxed);
+    counts.passed.fetch_add(passed, std::memory_order_relaxed);
+}
+
+void
+SearchKernel::getCascadeStats(uint64_t& tested, uint64_t& passed) const {
+    tested = passed = 0;
+    for (int i = 0; (i < numCounts); i++) {
+        tested += cascadeCounts[i].tested;
+        passed += cascadeCounts[i].passed;
+    }
+}
+
+ScoreMetric
+SearchKernel::toMetric(const std::string& name) {
+    if (name == "tolerance") {
+        return ScoreMetric::Tolerance;
+    } else if (name == "sad") {
+        return ScoreMetric::SAD;
+    } else if (name == "ssd") {
+        return ScoreMetric::SSD;
+    } else if (name == "ncc") {
+        return ScoreMetric::NCC;
+    }
+    throw std::invalid_argument("Invalid metric: " + name);
+}
+
+#endif
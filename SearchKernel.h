@@ -0,0 +1,357 @@
+#ifndef SEARCH_KERNEL_H
+#define SEARCH_KERNEL_H
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include "PNG.h"
+#include "SSDMap.h"
+
+/**
+   The different metrics that can be used to score a window of the
+   image against the mask or sub-image.
+*/
+enum class ScoreMetric {
+    Tolerance,  ///< +1/-1 per pixel based on tolerance (the default)
+    SAD,        ///< Sum of absolute differences
+    SSD,        ///< Sum of squared differences
+    NCC         ///< Normalized cross-correlation
+};
+
+/**
+   A mask or sub-image preprocessed into the form used by the search
+   kernels.
+*/
+struct SearchTemplate {
+    /** Create a template from the given mask or sub-image.
+
+        \param[in] img The mask or sub-image. The image must remain
+        valid while this template is in use.
+
+        \param[in] isMask Flag to indicate if img is to be treated as a
+        black-and-white mask.
+
+        \param[in] channels The number of channels that are compared.
+    */
+    SearchTemplate(const PNG& img, bool isMask, int channels);
+
+    /** The dimensions of the template. */
+    int width, height;
+
+    /** Flag to indicate if this template is a mask. */
+    bool isMask;
+
+    /** Pointer to the RGBA pixels of the template. */
+    const unsigned char* pixels;
+
+    /** One entry for each pixel: 1 if the pixel is (opaque) black and
+        0 otherwise.
+    */
+    std::vector<unsigned char> isBlack;
+
+    /** Sum of template values and the corresponding sum of squared
+        deviations (used for normalized cross-correlation).
+    */
+    double sumT, varT;
+};
+
+/**
+   Signature of the kernels that score a single window of the image.
+   See scoreWindow() in ScoringPolicies.h for details.
+*/
+using WindowScorer = float (*)(const unsigned char* img, int stride,
+                               const SearchTemplate& tmpl, int tolerance,
+                               Pixel* bgPix);
+
+/**
+   Signature of the kernels that score a strip of horizontally adjacent
+   windows of the image. See scoreStrip() in ScoringPolicies.h.
+*/
+using StripScorer = void (*)(const unsigned char* img, int stride,
+                             const SearchTemplate& tmpl, int tolerance,
+                             float* scores, Pixel* bgPix);
+
+/**
+   The kernel used to score windows of the image. The kernel is
+   specialized for the metric, number of channels, and mask mode when
+   it is constructed, so that the per-window cost does not include any
+   checks on these parameters.
+*/
+class SearchKernel {
+public:
+    /** The maximum number of windows scored by scoreStrip(). */
+    static constexpr int MaxStripWidth = 16;
+
+    /** The maximum number of mask pixels used by the cascade. */
+    static constexpr int MaxCascadeSamples = 256;
+
+    /** Create a kernel to search for the given mask or sub-image.
+
+        \param[in] mask The mask or sub-image to be searched for.
+
+        \param[in] isMask If true, mask is a black-and-white mask.
+
+        \param[in] metric The metric used to score windows.
+
+        \param[in] channels The number of channels compared (1 or 3).
+        A single channel suffices for grayscale images.
+
+        \param[in] matchPercent The percentage used to compute the
+        match threshold.
+
+        \param[in] tolerance The tolerance used by the metric.
+
+        \param[in] stripWidth The number of adjacent windows scored
+        together by scoreStrip() (8 or 16). Zero indicates that windows
+        are only scored one at a time.
+
+        \throws std::invalid_argument If channels is not 1 or 3 or if
+        stripWidth is not 0, 8, or 16.
+    */
+    SearchKernel(const PNG& mask, bool isMask, ScoreMetric metric,
+                 int channels, int matchPercent, int tolerance,
+                 int stripWidth = 0);
+
+    /** Compute the score of the window at the given location.
+
+        \param[in] img The image being searched.
+
+        \param[in] row The top row of the window.
+
+        \param[in] col The left column of the window.
+
+        \param[out] bgPix Optional pointer to store background color.
+
+        \return The score for the window.
+    */
+    float score(const PNG& img, const int row, const int col,
+                Pixel* bgPix = NULL) const {
+        if (ssdScores) {
+            return ssdScore(row, col, bgPix);
+        }
+        return scorer(img.getPixels() +
+                      (size_t(row) * img.getWidth() + col) * 4,
+                      img.getWidth() * 4, tmpl, tolerance, bgPix);
+    }
+
+    /** Compute the scores of getStripWidth() adjacent windows. This
+        method must be used only if getStripWidth() is not zero.
+
+        \param[in] img The image being searched.
+
+        \param[in] row The top row of the windows.
+
+        \param[in] col The left column of the first window.
+
+        \param[out] scores The scores of the windows.
+
+        \param[out] bgPix Optional array to store background colors.
+    */
+    void scoreStrip(const PNG& img, const int row, const int col,
+                    float* scores, Pixel* bgPix = NULL) const {
+        if (ssdScores) {
+            for (int j = 0; (j < stripWidth); j++) {
+                scores[j] = ssdScore(row, col + j,
+                                     (bgPix != NULL) ? &bgPix[j] : NULL);
+            }
+            return;
+        }
+        stripScorer(img.getPixels() +
+                    (size_t(row) * img.getWidth() + col) * 4,
+                    img.getWidth() * 4, tmpl, tolerance, scores, bgPix);
+    }
+
+    /** Determine which of the windows starting in a row are matches,
+        scoring full strips of windows together (if getStripWidth() is
+        not zero) and the remaining windows one at a time.
+
+        \param[in] img The image being searched.
+
+        \param[in] row The top row of the windows.
+
+        \param[in] numCols The number of windows (starting at column 0)
+        to be checked.
+
+        \param[out] hits One entry per window: 1 if the window is a match
+        and 0 otherwise.
+    */
+    void matchRow(const PNG& img, const int row, const int numCols,
+                  unsigned char* hits) const;
+
+    /** Enable a cascade in which windows are first scored on a small
+        subset of the mask pixels (using the same metric) and only the
+        windows that pass this prefilter are scored on all the pixels.
+        The subset is a systematic sample in raster order of the black
+        and the remaining mask pixels, in proportion to their numbers.
+        It is thereby stratified by both color and position. The
+        prefilter uses the match percentage lowered by the margin. The
+        cascade is not used for masks with fewer than 4 times as many
+        pixels as the subset, as it would not save any work.
+
+        \param[in] samples The number of mask pixels in the subset.
+
+        \param[in] margin The amount by which the match percentage is
+        lowered for the prefilter.
+    */
+    void setCascade(int samples, int margin);
+
+    /** Use the SSD of every window of the image, computed with FFTs,
+        in sub-image mode. With the SSD metric, the SSDs are the scores
+        of the windows. With the tolerance and SAD metrics, the SSD
+        bounds the score, and windows whose SSD is too large to match
+        are rejected by prefilter(). The map is not used with the NCC
+        metric.
+
+        \param[in] map The SSD of every window of the image being
+        searched. Windows are only scored in the image used for the map.
+
+        \throws std::invalid_argument If the template is a mask.
+    */
+    void setSSDMap(std::shared_ptr<const SSDMap> map);
+
+    /** Check the window at the given location with the cascade
+        prefilter (and the SSD map, if set). Windows always pass if
+        neither is enabled.
+
+        \param[in] img The image being searched.
+
+        \param[in] row The top row of the window.
+
+        \param[in] col The left column of the window.
+
+        \return true if the window is to be scored on all the pixels.
+    */
+    bool prefilter(const PNG& img, const int row, const int col) const;
+
+    /** Check getStripWidth() adjacent windows with the cascade
+        prefilter (and the SSD map, if set), using the strip kernel.
+        This method must be used only if getStripWidth() is not zero.
+
+        \param[in] img The image being searched.
+
+        \param[in] row The top row of the windows.
+
+        \param[in] col The left column of the first window.
+
+        \param[out] passed One entry per window: 1 if the window is to
+        be scored on all the pixels and 0 otherwise.
+    */
+    void prefilterStrip(const PNG& img, const int row, const int col,
+                        unsigned char* passed) const;
+
+    /** Obtain the number of windows checked by, and the number that
+        passed, the cascade prefilter.
+    */
+    void getCascadeStats(uint64_t& tested, uint64_t& passed) const;
+
+    /** The number of adjacent windows scored by scoreStrip(). */
+    int getStripWidth() const { return stripWidth; }
+
+    /** Determine if a window with the given score is a match. */
+    bool isMatch(const float score) const { return score > threshold; }
+
+    /** The score a window must exceed to be a match. */
+    float getThreshold() const { return threshold; }
+
+    /** The preprocessed template used by this kernel. */
+    const SearchTemplate& getTemplate() const { return tmpl; }
+
+    /** Convert the name of a metric ("tolerance", "sad", "ssd", or
+        "ncc").
+
+        \throws std::invalid_argument If the name is not valid.
+    */
+    static ScoreMetric toMetric(const std::string& name);
+
+private:
+    /** The template against which windows are scored. */
+    SearchTemplate tmpl;
+
+    /** The specialized kernel used to score windows. */
+    WindowScorer scorer;
+
+    /** The specialized kernel used to score strips of windows. */
+    StripScorer stripScorer = NULL;
+
+    /** The number of windows scored by stripScorer. */
+    int stripWidth;
+
+    /** The tolerance passed on to the kernel. */
+    int tolerance;
+
+    /** The score a window must exceed to be a match. */
+    float threshold;
+
+    /** The parameters used to create the cascade kernel. */
+    ScoreMetric metric;
+    int channels, matchPercent;
+
+    /** The subset of the mask pixels used by the cascade (as a 1-column
+        image) and the kernel that scores windows on the subset.
+    */
+    PNG cascadeMask;
+    std::unique_ptr<SearchKernel> cascade;
+
+    /** The location (in the mask) of each pixel in the subset. */
+    std::vector<int> sampleRows, sampleCols;
+
+    /** The SSD of every window of the image (NULL if not used). */
+    std::shared_ptr<const SSDMap> ssdMap;
+
+    /** Flag to indicate if the SSDs in ssdMap are the scores. */
+    bool ssdScores = false;
+
+    /** Windows with a larger SSD than this cannot be matches. */
+    double ssdLimit = 0;
+
+    /** The score of a window from ssdMap (with the SSD metric). */
+    float ssdScore(const int row, const int col, Pixel* bgPix) const {
+        if (bgPix != NULL) {
+            *bgPix = Pixel{ .rgba = 0xff'00'00'00U };  // No background
+        }
+        return -float(ssdMap->at(row, col));
+    }
+
+    /** Determine if the SSD of a window does not rule out a match. */
+    bool withinSSDLimit(const int row, const int col) const {
+        return (ssdMap == NULL) || ssdScores ||
+            (ssdMap->at(row, col) <= ssdLimit);
+    }
+
+    /** Record the windows tested by, and passed by, the cascade. */
+    void countCascade(const int tested, const int passed) const;
+
+    /** Per-thread counts of windows checked by, and passed by, the
+        cascade. Each entry is on a separate cache line.
+    */
+    struct alignas(64) CascadeCounts {
+        std::atomic<uint64_t> tested{0}, passed{0};
+    };
+    std::unique_ptr<CascadeCounts[]> cascadeCounts;
+
+    /** The number of entries in cascadeCounts. */
+    int numCounts = 0;
+};
+
+#endif
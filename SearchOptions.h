@@ -0,0 +1,145 @@
+#ifndef SEARCH_OPTIONS_H
+#define SEARCH_OPTIONS_H
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include "SearchKernel.h"
+#include "MatchedRect.h"
+#include "MatchStream.h"
+#include "AutoTuner.h"
+
+/**
+   A simple structure to hold the optional settings (specified as
+   --name=value command-line arguments) that influence how an image
+   search is performed.  The default values reproduce the behavior of
+   a plain search.
+*/
+struct SearchOptions {
+    /** Flag to indicate if decoded images are to be cached in (and
+        loaded from) sidecar files.
+    */
+    bool useCache = false;
+
+    /** The directory in which sidecar files are stored. If this is
+        empty, sidecars are stored alongside the source images.
+    */
+    std::string cacheDir;
+
+    /** The metric used to score each window of the image. */
+    ScoreMetric metric = ScoreMetric::Tolerance;
+
+    /** The number of color channels compared (1 or 3). */
+    int channels = 3;
+
+    /** The binary trace file to which scored windows are logged. No
+        trace is generated if this string is empty.
+    */
+    std::string traceFile;
+
+    /** Only 1 out of traceSample windows is logged. */
+    int traceSample = 1;
+
+    /** Only windows whose top-left corner lies in this region are
+        logged. An empty region implies the whole image.
+    */
+    MatchedRect traceRoi;
+
+    /** How matches are reported: all at the end (sorted), as they are
+        found, or as they are found but in row-major order.
+    */
+    MatchStream::Mode streamMode = MatchStream::Batch;
+
+    /** Stop the search once this many matches have been reported. Zero
+        indicates no limit.
+    */
+    size_t maxMatches = 0;
+
+    /** Stop the search once this many seconds (of wall-clock time) have
+        elapsed. Zero indicates no limit.
+    */
+    double timeBudget = 0;
+
+    /** The factors by which the mask is resized, from largest to
+        smallest, for a multi-scale search. If this list is empty, only
+        the mask as-is is searched for.
+    */
+    std::vector<double> scales;
+
+    /** The highest level of the image pyramid on which windows are
+        screened in a multi-scale search. Zero disables screening.
+    */
+    int pyramidLevels = 2;
+
+    /** The amount by which the match percentage is lowered when
+        screening windows on a coarse level of the image pyramid.
+    */
+    int pyramidSlack = 10;
+
+    /** The number of mask pixels on which windows are scored by the
+        cascade prefilter. Zero disables the cascade.
+    */
+    int cascadeSamples = 0;
+
+    /** The amount by which the match percentage is lowered for the
+        cascade prefilter.
+    */
+    int cascadeMargin = 25;
+
+    /** When the SSD of all the windows is computed with FFTs (only in
+        sub-image mode), to score windows with the SSD metric or to
+        reject windows with the tolerance and SAD metrics.
+    */
+    SSDMap::Mode fftMode = SSDMap::Auto;
+
+    /** The parallel layout of the search: threads, schedule, and the
+        number of adjacent windows scored together by the kernels.
+    */
+    TuneConfig layout;
+
+    /** Flag to indicate if the layout is to be calibrated (and stored
+        in the tuning profile) before the search.
+    */
+    bool tune = false;
+
+    /** The match percentages and tolerances for a parameter sweep. If
+        either list is not empty, matches are reported for every
+        combination instead of performing a regular search. An empty
+        list is replaced by the match percentage (or tolerance) given
+        on the command-line.
+    */
+    std::vector<int> sweepPercents, sweepTolerances;
+
+    /** The file in which the state of the search is persisted. If set,
+        only the windows overlapping regions of the image that changed
+        since the previous search are scored again.
+    */
+    std::string stateFile;
+
+    /** The tuning profile from which the layout is loaded (unless the
+        layout was specified on the command-line). No profile is used
+        if this string is empty.
+    */
+    std::string profileFile;
+};
+
+#endif
@@ -0,0 +1,339 @@
+#ifndef SEARCH_STATE_CPP
+#define SEARCH_STATE_CPP
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
+#include "SearchState.h"
+
+namespace {
+    /** The magic string at the start of every state file. */
+    constexpr char Magic[8] = "ISSTATE";
+
+    /** The version of the state file format. */
+    constexpr uint32_t Version = 1;
+
+    /** The same multiply-xorshift hash used by ImageCache::hashFile. */
+    uint64_t hashBytes(uint64_t hash, const unsigned char* data,
+                       const size_t size) {
+        constexpr uint64_t Prime = 0x9E3779B97F4A7C15ULL;
+        size_t i = 0;
+        for (; (i + 8 <= size); i += 8) {
+            uint64_t word;
+            std::memcpy(&word, data + i, sizeof(word));
+            hash = (hash ^ word) * Prime;
+            hash ^= (hash >> 32);
+        }
+        for (; (i < size); i++) {
+            hash = (hash ^ data[i]) * Prime;
+        }
+        return hash;
+    }
+
+    /** Helper to write bytes to the state file, checking for errors. */
+    void writeBytes(FILE* fp, const void* data, const size_t size) {
+        if ((size > 0) && (fwrite(data, 1, size, fp) != size)) {
+            throw std::runtime_error("Error writing search state");
+        }
+    }
+
+    /** Helper to read bytes from the state file. */
+    bool readBytes(FILE* fp, void* data, const size_t size) {
+        return (size == 0) || (fread(data, 1, size, fp) == size);
+    }
+}
+
+SearchState::SearchState(const PNG& mask, bool isMask, ScoreMetric metric,
+                         int channels, int matchPercent, int tolerance) :
+    mask(mask), kernel(mask, isMask, metric, channels, matchPercent,
+                       tolerance, SearchKernel::MaxStripWidth),
+    isMask(isMask), metric(metric), channels(channels),
+    matchPercent(matchPercent), tolerance(tolerance) {
+}
+
+SearchState::Header
+SearchState::makeHeader() const {
+    Header hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    std::memcpy(hdr.magic, Magic, sizeof(Magic));
+    hdr.version      = Version;
+    hdr.imgWidth     = width;
+    hdr.imgHeight    = height;
+    hdr.maskWidth    = mask.getWidth();
+    hdr.maskHeight   = mask.getHeight();
+    hdr.isMask       = isMask;
+    hdr.metric       = static_cast<int>(metric);
+    hdr.channels     = channels;
+    hdr.matchPercent = matchPercent;
+    hdr.tolerance    = tolerance;
+    hdr.tileSize     = TileSize;
+    hdr.maskHash     = hashBytes(0, mask.getPixels(), mask.getBufferSize());
+    hdr.numMatches   = matches.size();
+    return hdr;
+}
+
+bool
+SearchState::load(const std::string& path, int width, int height) {
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    this->width  = width;
+    this->height = height;
+    Header hdr, expected = makeHeader();
+    // The header must match, except for the number of matches.
+    bool valid = readBytes(fp, &hdr, sizeof(hdr));
+    expected.numMatches = hdr.numMatches;
+    valid = valid && (std::memcmp(&hdr, &expected, sizeof(hdr)) == 0);
+    const int tilesX  = (width  + TileSize - 1) / TileSize;
+    const int tilesY  = (height + TileSize - 1) / TileSize;
+    const int numRows = std::max(0, height - mask.getHeight() + 1);
+    const int numCols = std::max(0, width  - mask.getWidth()  + 1);
+    const size_t numTiles = size_t(tilesX) * tilesY;
+    const size_t numWindows = size_t(numRows) * numCols;
+    // The number of matches is not trusted until the size of the file
+    // is known to be consistent with it.
+    struct stat info;
+    valid = valid && (fstat(fileno(fp), &info) == 0) &&
+        (hdr.numMatches <= numWindows) &&
+        (uint64_t(info.st_size) == sizeof(hdr) +
+         numTiles * sizeof(uint64_t) + numWindows * sizeof(float) +
+         hdr.numMatches * 4 * sizeof(int32_t));
+    if (valid) {
+        tileHashes.resize(numTiles);
+        scores.resize(numWindows);
+        std::vector<int32_t> coords(hdr.numMatches * 4);
+        valid = readBytes(fp, tileHashes.data(),
+                          tileHashes.size() * sizeof(uint64_t)) &&
+            readBytes(fp, scores.data(), scores.size() * sizeof(float)) &&
+            readBytes(fp, coords.data(), coords.size() * sizeof(int32_t));
+        matches.clear();
+        for (size_t i = 0; (i < coords.size()) && valid; i += 4) {
+            const MatchedRect rect(coords[i], coords[i + 1],
+                                   mask.getWidth(), mask.getHeight());
+            // Each match must be a window of the image.
+            valid = (rect.row1 >= 0) && (rect.row1 < numRows) &&
+                (rect.col1 >= 0) && (rect.col1 < numCols) &&
+                (rect.row2 == coords[i + 2]) && (rect.col2 == coords[i + 3]);
+            matches.push_back(rect);
+        }
+    }
+    fclose(fp);
+    if (!valid) {
+        // Do not keep a partially read state.
+        tileHashes.clear();
+        scores.clear();
+        matches.clear();
+    }
+    loaded = valid;
+    return valid;
+}
+
+std::vector<uint64_t>
+SearchState::hashTiles(const PNG& img) const {
+    const int tilesX = (img.getWidth()  + TileSize - 1) / TileSize;
+    const int tilesY = (img.getHeight() + TileSize - 1) / TileSize;
+    std::vector<uint64_t> hashes(size_t(tilesX) * tilesY);
+#pragma omp parallel for schedule(dynamic)
+    for (int ty = 0; ty < tilesY; ty++) {
+        const int rowEnd = std::min(img.getHeight(), (ty + 1) * TileSize);
+        for (int tx = 0; (tx < tilesX); tx++) {
+            const int col = tx * TileSize;
+            const int cols = std::min(TileSize, img.getWidth() - col);
+            uint64_t hash = 0xCBF29CE484222325ULL;
+            for (int row = ty * TileSize; (row < rowEnd); row++) {
+                hash = hashBytes(hash, img.getPixels() +
+                                 (size_t(row) * img.getWidth() + col) * 4,
+                                 cols * 4);
+            }
+            hashes[size_t(ty) * tilesX + tx] = hash;
+        }
+    }
+    return hashes;
+}
+
+void
+SearchState::update(const PNG& img) {
+    const int numRows = std::max(0, img.getHeight() - mask.getHeight() + 1);
+    const int numCols = std::max(0, img.getWidth()  - mask.getWidth()  + 1);
+    std::vector<uint64_t> newHashes = hashTiles(img);
+    // The ranges of columns of windows to be scored in each row.
+    std::vector<std::vector<std::pair<int, int>>> dirty(numRows);
+    if (!loaded) {
+        width  = img.getWidth();
+        height = img.getHeight();
+        scores.assign(size_t(numRows) * numCols, 0);
+        for (int row = 0; (row < numRows) && (numCols > 0); row++) {
+            dirty[row].push_back({0, numCols - 1});
+        }
+        changedTiles = newHashes.size();
+        matches.clear();
+    } else {
+        changedTiles = 0;
+        const int tilesX = (width + TileSize - 1) / TileSize;
+        for (size_t tile = 0; (tile < newHashes.size()); tile++) {
+            if (newHashes[tile] == tileHashes[tile]) {
+                continue;
+            }
+            changedTiles++;
+            // The windows that overlap the tile.
+            const int ty = tile / tilesX, tx = tile % tilesX;
+            const int row1 = std::max(0, ty * TileSize - mask.getHeight() + 1);
+            const int row2 = std::min(numRows - 1, (ty + 1) * TileSize - 1);
+            const int col1 = std::max(0, tx * TileSize - mask.getWidth() + 1);
+            const int col2 = std::min(numCols - 1, (tx + 1) * TileSize - 1);
+            for (int row = row1; (row <= row2) && (col1 <= col2); row++) {
+                dirty[row].push_back({col1, col2});
+            }
+        }
+        // Merge the overlapping ranges in each row.
+        for (auto& ranges : dirty) {
+            std::sort(ranges.begin(), ranges.end());
+            size_t last = 0;
+            for (size_t i = 1; (i < ranges.size()); i++) {
+                if (ranges[i].first <= ranges[last].second + 1) {
+                    ranges[last].second = std::max(ranges[last].second,
+                                                   ranges[i].second);
+                } else {
+                    ranges[++last] = ranges[i];
+                }
+            }
+            ranges.resize(std::min(ranges.size(), last + 1));
+        }
+    }
+    tileHashes = std::move(newHashes);
+    score(img, dirty);
+    prevMatches = matches;
+    matches     = selectMatches();
+}
+
+void
+SearchState::score(const PNG& img,
+                   const std::vector<std::vector<std::pair<int, int>>>& cols) {
+    const int numCols    = std::max(0, width - mask.getWidth() + 1);
+    const int stripWidth = kernel.getStripWidth();
+    scoredWindows = 0;
+    for (const auto& ranges : cols) {
+        for (const auto& range : ranges) {
+            scoredWindows += range.second - range.first + 1;
+        }
+    }
+#pragma omp parallel for default(shared) schedule(runtime)
+    for (int row = 0; row < int(cols.size()); row++) {
+        float* rowScores = &scores[size_t(row) * numCols];
+        for (const auto& range : cols[row]) {
+            int col = range.first;
+            for (; (col + stripWidth - 1 <= range.second); col += stripWidth) {
+                kernel.scoreStrip(img, row, col, rowScores + col);
+            }
+            for (; (col <= range.second); col++) {
+                rowScores[col] = kernel.score(img, row, col);
+            }
+        }
+    }
+}
+
+MatchedRectList
+SearchState::selectMatches() const {
+    const int numCols = std::max(0, width - mask.getWidth() + 1);
+    const int numRows = (numCols > 0) ? (scores.size() / numCols) : 0;
+    const int mw = mask.getWidth(), mh = mask.getHeight();
+    // Windows (in the current or later rows) in a column overlap an
+    // earlier match if they start at or before this row.
+    std::vector<int> blockedUntil(numCols, -1);
+    MatchedRectList result;
+    for (int row = 0; (row < numRows); row++) {
+        const float* rowScores = &scores[size_t(row) * numCols];
+        for (int col = 0; (col < numCols); col++) {
+            if (!kernel.isMatch(rowScores[col]) ||
+                (row <= blockedUntil[col])) {
+                continue;
+            }
+            result.push_back(MatchedRect(row, col, mw, mh));
+            // Same overlap test as MatchedRect::intersects()
+            const int endCol = std::min(numCols - 1, col + mw);
+            for (int c = std::max(0, col - mw); (c <= endCol); c++) {
+                blockedUntil[c] = std::max(blockedUntil[c], row + mh);
+            }
+        }
+    }
+    return result;
+}
+
+void
+SearchState::save(const std::string& path) const {
+    const Header hdr = makeHeader();
+    std::vector<int32_t> coords;
+    for (const auto& rect : matches) {
+        coords.insert(coords.end(), {rect.row1, rect.col1, rect.row2,
+                                     rect.col2});
+    }
+    const std::string tmpPath = path + ".tmp." + std::to_string(getpid());
+    FILE* fp = fopen(tmpPath.c_str(), "wb");
+    if (fp == NULL) {
+        throw std::runtime_error("Search state (" + tmpPath + ") could not "
+                                 "be opened for writing");
+    }
+    try {
+        writeBytes(fp, &hdr, sizeof(hdr));
+        writeBytes(fp, tileHashes.data(), tileHashes.size() * sizeof(uint64_t));
+        writeBytes(fp, scores.data(), scores.size() * sizeof(float));
+        writeBytes(fp, coords.data(), coords.size() * sizeof(int32_t));
+    } catch (const std::runtime_error&) {
+        fclose(fp);
+        unlink(tmpPath.c_str());
+        throw;
+    }
+    if ((fclose(fp) != 0) || (rename(tmpPath.c_str(), path.c_str()))) {
+        unlink(tmpPath.c_str());
+        throw std::runtime_error("Error writing search state " + path);
+    }
+}
+
+void
+SearchState::report(std::ostream& os) const {
+    if (!loaded) {
+        os << "Search state: scored all " << scoredWindows << " windows "
+           << "(no valid previous state)" << std::endl;
+        return;
+    }
+    // Both lists are in row-major order.
+    MatchedRectList added, removed;
+    std::set_difference(matches.begin(), matches.end(), prevMatches.begin(),
+                        prevMatches.end(), std::back_inserter(added));
+    std::set_difference(prevMatches.begin(), prevMatches.end(),
+                        matches.begin(), matches.end(),
+                        std::back_inserter(removed));
+    const size_t total = scores.size();
+    os << "Search state: " << changedTiles << " of " << tileHashes.size()
+       << " tiles changed, rescored " << scoredWindows << " of " << total
+       << " windows (" << (total ? scoredWindows * 100.0 / total : 0)
+       << "%), " << added.size() << " matches added, " << removed.size()
+       << " removed" << std::endl;
+}
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef SEARCH_STATE_H
+#define SEARCH_STATE_H
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "PNG.h"
+#include "SearchKernel.h"
+#include "MatchedRect.h"
+
+/**
+   The persistent state of a search that allows a modified version of
+   the image to be searched again incrementally. The state consists of
+   the score of every window, a hash of each tile of the image, and the
+   matches found.
+
+   When a new version of the image is searched, the tiles whose hashes
+   changed are dirty. Only the windows that overlap a dirty tile are
+   scored again. The matches are then selected from the scores by the
+   same greedy, row-major selection of non-overlapping windows as the
+   regular search, which repairs the matches around the changes. The
+   cost of scoring is thereby proportional to the changed area.
+
+   The state is only valid for the same image dimensions, mask, and
+   search parameters. Otherwise, all windows are scored. The state file
+   uses the native byte order.
+*/
+class SearchState {
+public:
+    /** The width and height of the tiles that are hashed. */
+    static constexpr int TileSize = 64;
+
+    /** Setup the state for a search with the given parameters.
+
+        \param[in] mask The mask (or sub-image) to be searched for. The
+        mask must remain valid while this state is in use.
+
+        \param[in] isMask If true, mask is a black-and-white mask.
+
+        \param[in] metric The metric used to score windows.
+
+        \param[in] channels The number of channels compared (1 or 3).
+
+        \param[in] matchPercent The percentage used to compute the
+        match threshold.
+
+        \param[in] tolerance The tolerance used by the metric.
+    */
+    SearchState(const PNG& mask, bool isMask, ScoreMetric metric,
+                int channels, int matchPercent, int tolerance);
+
+    /** Load the state saved by an earlier search.
+
+        \param[in] path The file from which the state is loaded.
+
+        \param[in] width The width of the image to be searched.
+
+        \param[in] height The height of the image to be searched.
+
+        \return This method returns false if the file does not exist or
+        if the state is not valid for the image and search parameters.
+        The state is also not valid if the size of the file or the
+        matches in it are not consistent with the image, in which case
+        update() scores all the windows.
+    */
+    bool load(const std::string& path, int width, int height);
+
+    /** Update the scores and matches for (a new version of) the image.
+        If no state was loaded, all the windows are scored. Otherwise,
+        only the windows that overlap changed tiles are scored.
+
+        \param[in] img The image being searched.
+    */
+    void update(const PNG& img);
+
+    /** Save the state. The state is written to a temporary file and
+        renamed.
+
+        \param[in] path The file to which the state is saved.
+
+        \throws std::runtime_error On errors writing the file.
+    */
+    void save(const std::string& path) const;
+
+    /** The matches found by the last call to update(). */
+    const MatchedRectList& getMatches() const { return matches; }
+
+    /** Print a summary of the work done by the last update(), including
+        the matches that were added or removed.
+    */
+    void report(std::ostream& os) const;
+
+private:
+    /** The fixed-size header of a state file. */
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        int32_t imgWidth, imgHeight, maskWidth, maskHeight;
+        int32_t isMask, metric, channels, matchPercent, tolerance;
+        int32_t tileSize;
+        uint64_t maskHash, numMatches;
+    };
+
+    /** Create the header describing this state. */
+    Header makeHeader() const;
+
+    /** Compute the hash of each tile of the image. */
+    std::vector<uint64_t> hashTiles(const PNG& img) const;
+
+    /** Score all the windows in the given ranges of columns. Entry i
+        of the list has the ranges of columns of window row i.
+    */
+    void score(const PNG& img,
+               const std::vector<std::vector<std::pair<int, int>>>& cols);
+
+    /** Select the non-overlapping matches from the scores. */
+    MatchedRectList selectMatches() const;
+
+    /** The mask being searched for. */
+    const PNG& mask;
+
+    /** The kernel used to score windows. */
+    SearchKernel kernel;
+
+    /** The parameters of the search (stored in the state file). */
+    const bool isMask;
+    const ScoreMetric metric;
+    const int channels, matchPercent, tolerance;
+
+    /** The dimensions of the image the state is for. */
+    int width = 0, height = 0;
+
+    /** The hash of each tile of the image (in row-major order). */
+    std::vector<uint64_t> tileHashes;
+
+    /** The score of each window (in row-major order). */
+    std::vector<float> scores;
+
+    /** The matches found by the last search, and the ones before. */
+    MatchedRectList matches, prevMatches;
+
+    /** Flag to indicate if a valid state was loaded. */
+    bool loaded = false;
+
+    /** The number of tiles that changed and windows scored by update(). */
+    size_t changedTiles = 0, scoredWindows = 0;
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef TRACER_CPP
+#define TRACER_CPP
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <omp.h>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include "Tracer.h"
+
+Tracer::Tracer(const std::string& fileName, TraceHeader hdr,
+               const std::string& imgFile, const std::string& maskFile) :
+    roi(hdr.roi[0], hdr.roi[1], hdr.roi[3] - hdr.roi[1],
+        hdr.roi[2] - hdr.roi[0]), sampleRate(hdr.sampleRate) {
+    fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        throw std::runtime_error("Trace file (" + fileName + ") could not "
+                                 "be opened for writing");
+    }
+    // Write the header followed by the names of the image files.
+    std::memcpy(hdr.magic, "ISTRACE", 8);
+    hdr.version        = 1;
+    hdr.recordSize     = sizeof(TraceRecord);
+    hdr.nameLengths[0] = imgFile.size();
+    hdr.nameLengths[1] = maskFile.size();
+    const std::string names = imgFile + maskFile;
+    if ((write(fd, &hdr, sizeof(hdr)) != sizeof(hdr)) ||
+        (write(fd, names.data(), names.size()) != ssize_t(names.size()))) {
+        close(fd);
+        throw std::runtime_error("Error writing trace header");
+    }
+    fileOffset = sizeof(hdr) + names.size();
+    // Create the per-thread buffers.
+    numBuffers = omp_get_max_threads();
+    buffers.reset(new Buffer[numBuffers]);
+    for (int i = 0; (i < numBuffers); i++) {
+        buffers[i].records.resize(BufferSize);
+    }
+}
+
+Tracer::~Tracer() {
+    flush();
+    close(fd);
+    if (dropped > 0) {
+        std::cerr << "Warning: " << dropped << " trace records from threads "
+                  << "beyond the " << numBuffers << " anticipated were "
+                  << "dropped\n";
+    }
+}
+
+void
+Tracer::log(const TraceRecord& rec) {
+    const int thread = omp_get_thread_num();
+    if (thread >= numBuffers) {
+        dropped++;  // Thread not anticipated when tracer was created
+        return;
+    }
+    Buffer& buf = buffers[thread];
+    buf.records[buf.count++] = rec;
+    if (buf.count == BufferSize) {
+        drain(buf);
+    }
+}
+
+void
+Tracer::drain(Buffer& buf) {
+    const size_t bytes = buf.count * sizeof(TraceRecord);
+    // Reserve space in the file for this chunk. No locks are needed.
+    const uint64_t offset = fileOffset.fetch_add(bytes);
+    if (pwrite(fd, buf.records.data(), bytes, offset) != ssize_t(bytes)) {
+        std::cerr << "Warning: Error writing trace records\n";
+    }
+    buf.count = 0;
+}
+
+void
+Tracer::flush() {
+    for (int i = 0; (i < numBuffers); i++) {
+        if (buffers[i].count > 0) {
+            drain(buffers[i]);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,179 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include "MatchedRect.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+/**
+   A single record in a trace file. One record is logged for each
+   candidate window that is scored (windows skipped because they
+   overlap an earlier match or fail the cascade prefilter are not
+   logged).
+*/
+struct TraceRecord {
+    int32_t  row, col;  // Top-left corner of the window.
+    float    score;     // Score computed by the search kernel.
+    uint32_t bgRGBA;    // Background color of the window (RGBA).
+    uint32_t cycles;    // Time stamp counter cycles to score window.
+    uint16_t thread;    // OpenMP thread that scored the window.
+    uint16_t matched;   // 1 if the window was reported as a match.
+};
+
+/**
+   The header at the start of a trace file. The header is followed by
+   the path of the image and the mask (nameLengths bytes) and then by
+   TraceRecords until the end of the file. Records from different
+   threads are interleaved in chunks.
+*/
+struct TraceHeader {
+    char     magic[8];          // "ISTRACE" plus a NUL terminator.
+    uint32_t version;           // Version of the trace format.
+    uint32_t recordSize;        // sizeof(TraceRecord).
+    int32_t  imgWidth, imgHeight;
+    int32_t  maskWidth, maskHeight;
+    int32_t  tolerance;         // Tolerance used for the search.
+    int32_t  matchPercent;      // Match percentage used for the search.
+    int32_t  isMask;            // 1 for a mask search, 0 otherwise.
+    int32_t  metric;            // The ScoreMetric used for scoring.
+    int32_t  sampleRate;        // 1 out of sampleRate windows is logged.
+    int32_t  roi[4];            // Region of interest (row1,col1,row2,col2)
+    float    threshold;         // Score a window must exceed to match.
+    uint32_t nameLengths[2];    // Length of image and mask paths.
+};
+
+/**
+   A low-overhead tracer that logs the candidate windows evaluated by
+   the search into a compact binary file.
+
+   Each OpenMP thread logs records into its own ring buffer (no locks
+   or atomics are needed for logging). When a thread's buffer fills
+   up, the thread reserves space at the end of the file via an atomic
+   counter and writes its buffer with pwrite. Hence threads never
+   wait for each other.  Use tools/TraceDecode to convert traces to
+   text.
+*/
+class Tracer {
+public:
+    /** Create a tracer that writes to the given file.
+
+        \param[in] fileName The path to the trace file to be created.
+
+        \param[in] hdr The header to be written. The magic, version,
+        recordSize, and nameLengths are filled-in by this constructor.
+
+        \param[in] imgFile The path to the image being searched.
+
+        \param[in] maskFile The path to the mask being searched for.
+
+        \throws std::runtime_error If the file cannot be created.
+    */
+    Tracer(const std::string& fileName, TraceHeader hdr,
+           const std::string& imgFile, const std::string& maskFile);
+
+    /** The destructor flushes all buffers and closes the file. */
+    ~Tracer();
+
+    /** Determine if a window is to be logged, based on the region of
+        interest and sampling rate.  Sampling is based on the position
+        of the window so the same windows are logged regardless of the
+        number of threads.
+    */
+    bool wants(const int row, const int col) const {
+        if ((row < roi.row1) || (row >= roi.row2) || (col < roi.col1) ||
+            (col >= roi.col2)) {
+            return false;
+        }
+        const uint32_t hash = (uint32_t(row) * 0x9E3779B1U) ^
+            (uint32_t(col) * 0x85EBCA77U);
+        return (sampleRate <= 1) || ((hash >> 7) % sampleRate == 0);
+    }
+
+    /** Log a record from the calling OpenMP thread. Records from
+        threads beyond omp_get_max_threads() at the time the tracer was
+        created are counted and reported (as a warning) when the tracer
+        is destroyed.
+    */
+    void log(const TraceRecord& rec);
+
+    /** Write out all the buffered records. Must be called outside of
+        a parallel region.
+    */
+    void flush();
+
+    /** Read the cycle counter used to time windows. */
+    static inline uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+
+private:
+    /** The number of records buffered by each thread. */
+    static constexpr size_t BufferSize = 4096;
+
+    /** A per-thread ring buffer, aligned to avoid false sharing. */
+    struct alignas(64) Buffer {
+        std::vector<TraceRecord> records;
+        size_t count = 0;
+    };
+
+    /** Helper method to write the records in a buffer to the file. */
+    void drain(Buffer& buf);
+
+    /** The file descriptor of the trace file. */
+    int fd;
+
+    /** The offset in the file at which the next chunk is written. */
+    std::atomic<uint64_t> fileOffset;
+
+    /** The region of interest. Only windows whose top-left corner is
+        in this region are logged.
+    */
+    MatchedRect roi;
+
+    /** Only one out of sampleRate windows is logged. */
+    int sampleRate;
+
+    /** One buffer per OpenMP thread. */
+    std::unique_ptr<Buffer[]> buffers;
+
+    /** The number of entries in buffers. */
+    int numBuffers;
+
+    /** The number of records from threads without a buffer. */
+    std::atomic<uint64_t> dropped{0};
+};
+
+#endif
@@ -28,125 +28,38 @@
 #include <unordered_map>
 #include <algorithm>
 #include <numeric>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <functional>
 #include <omp.h>
 #include "PNG.h"
 #include "MatchedRect.h"
+#include "ImageCache.h"
+#include "SearchOptions.h"
+#include "RowProgress.h"
+#include "SearchKernel.h"
+#include "Tracer.h"
+#include "MatchStream.h"
+#include "ImagePyramid.h"
+#include "ScaleSearch.h"
+#include "AutoTuner.h"
+#include "ParameterSweep.h"
+#include "SearchState.h"
+#include "RawImage.h"
 
 // It is ok to use the following namespace delarations in C++ source
 // files only. They must never be used in header files.
 using namespace std;
 using namespace std::string_literals;
 
-/**
- * Helper method to compute the average background pixel color for a given 
- * region of the image based on a max. 
- * 
- * \param[in] img1 The image whose region is used to be used to compute the
- * average pixel color.
- * 
- * \param[in] mask The mask to be used to determine the pixels that logically
- * constitute the background.
- * 
- * \param[in] startRow The starting row in img1
- * 
- * \param[in] endRow The starting column in img1 
- * 
- * \param[in] maxRow The maximum number of rows from the starting row to be used
- * to compute the background. This is zero-based to ensure that the computation
- * does not exceed the image size.
- * 
- * \param[in] maxCol The maximum number of columns from the starting column to be 
- * used to compute the background. This is zero-based to ensure that the 
- * computation does not exceed the image size.
- * 
- * \return Returns the average pixel color for the given region.
- */
-Pixel computeBackgroundPixel(const PNG& img1, const PNG& mask,
-        const int startRow, const int startCol,
-        const int maxRow, const int maxCol) {
-    const Pixel Black{ .rgba = 0xff'00'00'00U };
-    int red = 0, blue = 0, green = 0, count = 0;
-    for (int row = 0; (row < maxRow); row++) {
-        for (int col = 0; (col < maxCol); col++) {
-            if (mask.getPixel(row, col).rgba == Black.rgba) {
-                const auto pix = img1.getPixel(row + startRow, col + startCol);
-                red   += pix.color.red;
-                green += pix.color.green;
-                blue  += pix.color.blue;
-                count++;
-            }
-        }
-    }
-    // Compute the average color for each of the channels. 
-    const unsigned char avgRed  = (red / count), avgGreen = (green / count),
-                        avgBlue = (blue / count);
-    return {.color = {avgRed, avgGreen, avgBlue, 255}};
-}
-
-/**
- * Helper method to compute the average background pixel color for a given 
- * region of the image based on a max. 
- * 
- * \param[in] img1 The image whose region is used to be used to compute the
- * average pixel color.
- * 
- * \param[in] mask The mask to be used to determine the pixels that logically
- * constitute the background.
- * 
- * \param[in] startRow The starting row in img1
- * 
- * \param[in] endRow The starting column in img1 
- * 
- * \param[in] maxRow The maximum number of rows from the starting row to be used
- * to compute the background. This is zero-based to ensure that the computation
- * does not exceed the image size.
- * 
- * \param[in] maxCol The maximum number of columns from the starting column to be 
- * used to compute the background. This is zero-based to ensure that the 
- * computation does not exceed the image size.
- * 
- * \param[in] tolerance The acceptable tolerance on the red, green, or blue
- * channels for each pixel.
- * 
- * \return Returns the average pixel color for the given region.
- */
-int getMatchingPixCount(const PNG& img1, const PNG& mask,
-        const int startRow, const int startCol,
-        const int maxRow, const int maxCol, const int tolerance) {
-    const auto inTolerance = [&tolerance](int c1, int c2) 
-        { return std::abs(c1 - c2) < tolerance; };
-    const Pixel Black{ .rgba = 0xff'00'00'00U };
-
-    // First compute the average background pixel color.
-    const Pixel bgPix = computeBackgroundPixel(img1, mask, startRow, startCol, 
-        maxRow, maxCol);
-    int matchingPixelCount = 0;
-    for (int row = 0; (row < maxRow); row++) {
-        for (int col = 0; (col < maxCol); col++) {
-            const auto imgPix  = img1.getPixel(row + startRow, col + startCol);
-            const auto maskPix = mask.getPixel(row, col);
-            const bool isPixDiff =  
-                (inTolerance(imgPix.color.red,   bgPix.color.red)   &&
-                 inTolerance(imgPix.color.green, bgPix.color.green) &&
-                 inTolerance(imgPix.color.blue,  bgPix.color.blue));
-            const int addSub  = (maskPix.rgba == Black.rgba) ? -1 : 1;
-            matchingPixelCount += addSub * (isPixDiff ? -1 : 1);
-            /*
-            std::cout << row << '\t' << col << '\t'
-                      << "(" << (int) imgPix.color.red << ',' << (int) imgPix.color.green
-                      << ',' << (int) imgPix.color.blue << ")\t("
-                      << (int) maskPix.color.red << ',' << (int) maskPix.color.green
-                      << ',' << (int) maskPix.color.blue << '\t' << matchingPixelCount
-                      << std::endl;
-            */
-        }
-    }
-    return matchingPixelCount;
-}
-
 /**
  * This helper method is given to draw a rectangular box around a matching 
- * region.
+ * region. Note that the right edge is drawn on column box.col2, which is
+ * one column outside the region. MatchedRect::intersects() treats
+ * regions sharing that column as overlapping, so no other match (or
+ * window that is scored after a match is found) contains that column.
+ * Boxes are drawn only after the search, so they never affect scores.
  * 
  * \param[in] img The image in which the red box is to be drawn.
  * 
@@ -165,13 +78,30 @@ void drawRedBox(PNG& img, const MatchedRect& box) {
     }    
 }
 
+/**
+ * The score of a region computed ahead of time (together with adjacent
+ * regions) by a register-blocked strip kernel.
+ */
+struct RegionScore {
+    /** Flag to indicate if the region was scored. */
+    bool valid = false;
+    /** The score of the region. */
+    float score = 0;
+    /** The background color of the region (only if traced). */
+    Pixel bgPix{ .rgba = 0 };
+    /** The share of the cycles for scoring the strip (only if traced). */
+    uint64_t cycles = 0;
+    /** Result of the cascade prefilter (-1 if it was not checked). */
+    int prefiltered = -1;
+};
+
 /**
  * Helper method to check if a given region in an image matches the mask.
  * 
- * \param[in] img The main image for checking. A box is drawn in this image if
- * the given srchRgn matches.
+ * \param[in] img The main image for checking.
  * 
- * \param[in] mask The mask image to be used.
+ * \param[in] kernel The search kernel used to score the region against the
+ * mask (or sub-image).
  * 
  * \param[in] mrl The list of previous matched rectangular regions. These 
  * regions are to be ignored. 
@@ -179,14 +109,23 @@ void drawRedBox(PNG& img, const MatchedRect& box) {
  * \param[in] srchRgn The new rectangular region in the main img to be checked 
  * for a match.
  * 
- * \param[in] pixMatchNeeded The number of matching pixels needed to determine
- * if the specified region is a match.
+ * \param[in] tracer An optional tracer to which the score of the region is
+ * to be logged.
  * 
- * \param[in] tolerance The absolute acceptable difference between each color
- * channel when comparing  
+ * \param[in] preScore An optional score of the region computed earlier.
+ * If this score is not valid, the region is scored by this method.
  */
-bool checkMatchRegion(PNG& img, const PNG& mask, MatchedRectList& mrl, 
-    const MatchedRect& srchRgn, const int pixMatchNeeded, const int tolerance) {
+bool checkMatchRegion(const PNG& img, const SearchKernel& kernel,
+    MatchedRectList& mrl, const MatchedRect& srchRgn, Tracer* tracer = NULL,
+    const RegionScore* preScore = NULL) {
+    // Regions rejected by the (optional) cascade prefilter are not scored.
+    // The prefilter is cheaper than checking for overlaps, so it is first.
+    const bool passed = ((preScore != NULL) && (preScore->prefiltered >= 0)) ?
+        preScore->prefiltered : kernel.prefilter(img, srchRgn.row1,
+                                                 srchRgn.col1);
+    if (!passed) {
+        return false;
+    }
     // Check for matching regions
     bool matched;
 #pragma omp critical(resultVector) 
@@ -199,32 +138,335 @@ bool checkMatchRegion(PNG& img, const PNG& mask, MatchedRectList& mrl,
         return false;  // not matched
     }
 
-    // Next compute the pixels that match based on tolerance
-    const int matchingPixs = getMatchingPixCount(img, mask, srchRgn.row1,
-        srchRgn.col1, srchRgn.row2 - srchRgn.row1, 
-        srchRgn.col2 - srchRgn.col1, tolerance);
-    if (matchingPixs > pixMatchNeeded) {
-        // Found a matching region.
-        // std::cout << srchRgn << std::endl;
-#pragma omp critical(drawing)
-        drawRedBox(img, srchRgn);  // hope this won't cause a race condition
+    // Next score the region using the kernel (based on tolerance by default)
+    const bool trace = (tracer != NULL) &&
+        tracer->wants(srchRgn.row1, srchRgn.col1);
+    RegionScore rs;
+    if ((preScore != NULL) && preScore->valid) {
+        rs = *preScore;
+    } else {
+        const uint64_t startCycles = trace ? Tracer::cycles() : 0;
+        rs.score  = kernel.score(img, srchRgn.row1, srchRgn.col1,
+                                 trace ? &rs.bgPix : NULL);
+        rs.cycles = trace ? (Tracer::cycles() - startCycles) : 0;
+    }
+    const float score = rs.score;
+    matched = kernel.isMatch(score);
+    if (matched) {
+        // Found a matching region. The box is drawn after the search, as
+        // other threads may be reading the pixels in img.
 #pragma omp critical(resultVector)
     {
         mrl.push_back(srchRgn);  // add matched region to list of matches
     }
-        return true;  // found a matching region!
     }
-    return false;  // no match
+    if (trace) {
+        tracer->log({srchRgn.row1, srchRgn.col1, score, rs.bgPix.rgba,
+                     uint32_t(std::min<uint64_t>(rs.cycles, UINT32_MAX)),
+                     uint16_t(omp_get_thread_num()), uint16_t(matched)});
+    }
+    return matched;  // true if found a matching region!
 }
 
-void processResult(MatchedRectList& mrl, PNG& img) {
-    // Sort the result
-    std::sort(mrl.begin(), mrl.end());
-    // For each rectangular in a sorted order
+/**
+ * Helper method to score a strip of adjacent regions (starting in the same
+ * row) at each scale using the register-blocked kernels. A strip is scored
+ * only if it fits in the image and has enough regions that may need to be
+ * scored, i.e., that passed screening (and the cascade prefilter) and do not
+ * overlap earlier matches.
+ * Regions in the remaining strips are scored one at a time as needed.
+ * 
+ * \param[in] img The main image for checking.
+ * 
+ * \param[in] scales The scales at which the regions are checked.
+ * 
+ * \param[in] mrl The list of previous matched rectangular regions.
+ * 
+ * \param[in] row The top row of the regions in the strip.
+ * 
+ * \param[in] col The left column of the first region in the strip.
+ * 
+ * \param[in] trace If true, the background color and cycles are recorded.
+ * 
+ * \param[out] scores The scores of the regions at each scale. Entry
+ * s * stripWidth + j is for the j'th region in the strip at scale s.
+ */
+void scoreStrips(const PNG& img,
+                 const std::vector<std::unique_ptr<ScaleSearch>>& scales,
+                 MatchedRectList& mrl, const int row, const int col,
+                 const bool trace, std::vector<RegionScore>& scores) {
+    // Do not bother with strips in which only a few regions are scored.
+    constexpr int MinRegions = 4;
+    const int stripWidth = scales.front()->getKernel().getStripWidth();
+    float stripScores[SearchKernel::MaxStripWidth];
+    Pixel bgPix[SearchKernel::MaxStripWidth];
+    for (size_t s = 0; (s < scales.size()); s++) {
+        const PNG& scaledMask = scales[s]->getMask();
+        RegionScore* rs = &scores[s * stripWidth];
+        std::fill_n(rs, stripWidth, RegionScore());
+        if ((row + scaledMask.getHeight() > img.getHeight()) ||
+            (col + stripWidth + scaledMask.getWidth() - 1 > img.getWidth())) {
+            continue;  // Strip does not fit
+        }
+        // Apply the (optional) cascade prefilter to the whole strip.
+        const SearchKernel& kernel = scales[s]->getKernel();
+        unsigned char passed[SearchKernel::MaxStripWidth];
+        kernel.prefilterStrip(img, row, col, passed);
+        int regions = 0;
+        for (int j = 0; (j < stripWidth); j++) {
+            rs[j].prefiltered = passed[j];
+            regions += passed[j];
+        }
+        if (regions < MinRegions) {
+            continue;
+        }
+        // Count the regions that do not overlap earlier matches.
+        regions = 0;
+#pragma omp critical(resultVector)
+    {
+        for (int j = 0; (j < stripWidth); j++) {
+            regions += passed[j] && scales[s]->screen(row, col + j) &&
+                !mrl.isMatched(MatchedRect(row, col + j,
+                    scaledMask.getWidth(), scaledMask.getHeight()));
+        }
+    }
+        if (regions < MinRegions) {
+            continue;
+        }
+        const uint64_t startCycles = trace ? Tracer::cycles() : 0;
+        kernel.scoreStrip(img, row, col, stripScores, trace ? bgPix : NULL);
+        const uint64_t cycles = trace ? (Tracer::cycles() - startCycles) : 0;
+        for (int j = 0; (j < stripWidth); j++) {
+            rs[j].valid  = true;
+            rs[j].score  = stripScores[j];
+            rs[j].bgPix  = trace ? bgPix[j] : Pixel{ .rgba = 0 };
+            rs[j].cycles = cycles / stripWidth;
+        }
+    }
+}
+
+/**
+ * Draw boxes around the matched regions and print them (unless they
+ * were already printed as they were found).
+ * 
+ * \param[in] mrl The list of matched regions to be processed.
+ * 
+ * \param[in,out] img The image in which boxes are to be drawn.
+ * 
+ * \param[in] print If true, the matched regions are printed.
+ */
+void processResult(const MatchedRectList& mrl, PNG& img, const bool print) {
+    // For each rectangular in the order they were reported
     for (const auto& srchRgn : mrl) {
         // Process each matched region by drawing and printing
-        std::cout << srchRgn << std::endl;
-        // drawRedBox(img, srchRgn);
+        if (print) {
+            std::cout << srchRgn << std::endl;
+        }
+        drawRedBox(img, srchRgn);
+    }
+}
+
+/**
+ * Helper method to write an image to a PNG file or, if the name is a raw
+ * image specification (see RawImage), as uncompressed pixels.
+ * 
+ * \param[in] img The image to be written.
+ * 
+ * \param[in] fileName The PNG file or raw image specification.
+ */
+void writeImage(PNG& img, const std::string& fileName) {
+    if (RawImage::isRaw(fileName)) {
+        RawImage::write(fileName, img);
+    } else {
+        img.write(fileName);
+    }
+}
+
+/**
+ * Helper method to write the sidecar of the main image if it was not
+ * loaded from a valid sidecar or if sections (such as pyramid levels)
+ * were added to it. The sidecar is written once, after all the sections
+ * are known and before boxes are drawn on the image.
+ * 
+ * \param[in,out] cache The sidecar cache. NULL indicates that sidecars
+ * are not used.
+ * 
+ * \param[in] img The main image, which must have been loaded completely.
+ */
+void saveCache(ImageCache* cache, const PNG& img) {
+    if ((cache != NULL) && cache->isModified()) {
+        try {
+            cache->save(img);
+        } catch (const std::runtime_error& exp) {
+            // A failure to write the cache is not fatal.
+            std::cerr << "Warning: " << exp.what() << std::endl;
+        }
+    }
+}
+
+/**
+ * Helper method to load an image, optionally via a sidecar cache. If
+ * caching is enabled and a valid sidecar exists, the image is mapped from
+ * the sidecar without decoding the PNG. Otherwise the PNG is decoded and
+ * the cache is marked as modified, so that saveCache() writes a sidecar
+ * for use by subsequent runs. Raw images (see RawImage) are not decoded
+ * and hence never cached.
+ * 
+ * This method is run on a separate thread and reports its progress
+ * (including errors) to the given progress object. Rows of the PNG are
+ * published as they are decoded.
+ * 
+ * \param[out] img The image to be loaded.
+ * 
+ * \param[in] fileName The PNG file (or raw image specification) from
+ * where the image is to be loaded.
+ * 
+ * \param[in,out] cache The sidecar cache to be used. NULL indicates that
+ * sidecars are not used.
+ * 
+ * \param[out] progress The object to which progress is reported.
+ */
+void loadImage(PNG& img, const std::string& fileName, ImageCache* cache,
+               RowProgress& progress) {
+    try {
+        if (RawImage::isRaw(fileName)) {
+            RawImage::load(fileName, img, &progress);
+            return;
+        }
+        if (cache == NULL) {
+            img.load(fileName, progress);
+            return;
+        }
+        if (cache->load(img)) {
+            // All the rows are available right away.
+            progress.setSize(img.getWidth(), img.getHeight());
+            progress.publish(img.getHeight());
+            return;
+        }
+        img.load(fileName, progress);
+    } catch (...) {
+        progress.fail(std::current_exception());
+    }
+}
+
+/**
+ * Helper method to select the parallel layout of the search. If tuning is
+ * requested, the layout is calibrated on sample rows of the image and
+ * stored in the tuning profile. Otherwise, the layout is loaded from the
+ * profile (if the profile has an entry for this workload).
+ * 
+ * \param[in] img The main image to be searched.
+ * 
+ * \param[in] mask The mask (or sub-image) to be searched for.
+ * 
+ * \param[in] progress The progress of loading img. Tuning waits for all
+ * rows of the image.
+ * 
+ * \param[in] isMask If true, the mask is a black-and-white mask.
+ * 
+ * \param[in] matchPercent The percentage used for the match threshold.
+ * 
+ * \param[in] tolerance The tolerance used to compare pixels.
+ * 
+ * \param[in,out] opts The options whose layout is set by this method.
+ */
+void selectLayout(const PNG& img, const PNG& mask, RowProgress& progress,
+                  const bool isMask, const int matchPercent,
+                  const int tolerance, SearchOptions& opts) {
+    const std::string key = TuneProfile::makeKey(img, mask);
+    if (!opts.tune) {
+        TuneProfile(opts.profileFile).find(key, opts.layout);
+        return;
+    }
+    if (!progress.waitFor(img.getHeight())) {
+        return;  // Decoding failed (reported by the caller)
+    }
+    opts.layout = AutoTuner::calibrate(img, mask, isMask, opts.metric,
+                                       opts.channels, matchPercent,
+                                       tolerance, std::cerr);
+    if (!opts.profileFile.empty()) {
+        try {
+            TuneProfile(opts.profileFile).store(key, opts.layout);
+        } catch (const std::runtime_error& exp) {
+            std::cerr << "Warning: " << exp.what() << std::endl;
+        }
+    }
+}
+
+/**
+ * Helper method to report the matches for many combinations of match
+ * percentage and tolerance, scoring each window only once. The mask is
+ * searched for as-is (without scales or a cascade) and no output image
+ * is written.
+ * 
+ * \param[in] img The main image to be searched.
+ * 
+ * \param[in] mask The mask (or sub-image) to be searched for.
+ * 
+ * \param[in] progress The progress of loading img.
+ * 
+ * \param[in] isMask If true, the mask is a black-and-white mask.
+ * 
+ * \param[in] matchPercent The percentage used if no percentages are
+ * swept.
+ * 
+ * \param[in] tolerance The tolerance used if no tolerances are swept.
+ * 
+ * \param[in] opts The options with the percentages and tolerances.
+ */
+void sweepParameters(const PNG& img, const PNG& mask, RowProgress& progress,
+                     const bool isMask, const int matchPercent,
+                     const int tolerance, const SearchOptions& opts) {
+    ParameterSweep sweep(mask, isMask, opts.metric, opts.channels,
+        opts.sweepPercents.empty() ? std::vector<int>{matchPercent} :
+        opts.sweepPercents, opts.sweepTolerances.empty() ?
+        std::vector<int>{tolerance} : opts.sweepTolerances);
+    if (opts.layout.threads > 0) {
+        omp_set_num_threads(opts.layout.threads);
+    }
+    omp_set_schedule(opts.layout.schedule, opts.layout.chunkSize);
+    if (sweep.run(img, progress)) {
+        sweep.report(std::cout);
+    }
+}
+
+/**
+ * Search an image incrementally using the state persisted by a previous
+ * search of an earlier version of the image. Only the windows that
+ * overlap changed tiles of the image are scored. The state is updated
+ * for the next search.
+ * 
+ * \param[in,out] img The image to be searched. Matches are drawn on it.
+ * 
+ * \param[in] mask The mask (or sub-image) to be searched for.
+ * 
+ * \param[in] isMask If true, the mask is a black-and-white mask.
+ * 
+ * \param[in] matchPercent The percentage of pixels that must match.
+ * 
+ * \param[in] tolerance The tolerance used by the metric.
+ * 
+ * \param[in] opts The options with the state file and layout.
+ */
+void searchIncrementally(PNG& img, const PNG& mask, const bool isMask,
+                         const int matchPercent, const int tolerance,
+                         const SearchOptions& opts) {
+    SearchState state(mask, isMask, opts.metric, opts.channels,
+                      matchPercent, tolerance);
+    if (opts.layout.threads > 0) {
+        omp_set_num_threads(opts.layout.threads);
+    }
+    omp_set_schedule(opts.layout.schedule, opts.layout.chunkSize);
+    state.load(opts.stateFile, img.getWidth(), img.getHeight());
+    state.update(img);
+    processResult(state.getMatches(), img, true);
+    std::cout << "Number of matches: " << state.getMatches().size()
+              << std::endl;
+    state.report(std::cout);
+    try {
+        state.save(opts.stateFile);
+    } catch (const std::runtime_error& exp) {
+        std::cerr << "Warning: " << exp.what() << std::endl;
     }
 }
 
@@ -250,40 +492,253 @@ void processResult(MatchedRectList& mrl, PNG& img) {
  * 
  * \param[in] tolerance The absolute acceptable difference between each color
  * channel when comparing  
+ * 
+ * \param[in] opts Additional options that control the search. The layout
+ * of the search in these options may be replaced by a tuned layout.
  */
 void imageSearch(const std::string& mainImageFile,
                 const std::string& maskImageFile, 
                 const std::string& outImageFile, const bool isMask = true, 
-                const int matchPercent = 75, const int tolerance = 32) {
-    // Load the main image and the mask to be used.
+                const int matchPercent = 75, const int tolerance = 32,
+                SearchOptions opts = SearchOptions()) {
+    using Clock = std::chrono::steady_clock;
+    const auto deadline = Clock::now() +
+        std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(opts.timeBudget));
+    // Load the main image on a separate thread that publishes rows as they
+    // are decoded. Concurrently, load the mask on this thread.
     PNG img, mask;
-    img.load(mainImageFile);
-    mask.load(maskImageFile);
+    RowProgress progress;
+    std::unique_ptr<ImageCache> cache;
+    if (opts.useCache) {
+        cache = std::make_unique<ImageCache>(mainImageFile, opts.cacheDir);
+    }
+    std::thread producer(loadImage, std::ref(img), std::cref(mainImageFile),
+                         cache.get(), std::ref(progress));
+    try {
+        if (RawImage::isRaw(maskImageFile)) {
+            RawImage::load(maskImageFile, mask);
+        } else {
+            mask.load(maskImageFile);
+        }
+    } catch (...) {
+        producer.join();
+        throw;
+    }
+    if (!progress.waitForSize()) {
+        producer.join();
+        progress.rethrow();
+    }
+    // Use the tuned layout for this workload, calibrating it if requested.
+    if (opts.tune || !opts.profileFile.empty()) {
+        selectLayout(img, mask, progress, isMask, matchPercent, tolerance,
+                     opts);
+    }
+    if (!opts.sweepPercents.empty() || !opts.sweepTolerances.empty()) {
+        sweepParameters(img, mask, progress, isMask, matchPercent, tolerance,
+                        opts);
+        producer.join();
+        progress.rethrow();
+        saveCache(cache.get(), img);
+        return;
+    }
+    if (!opts.stateFile.empty()) {
+        producer.join();
+        progress.rethrow();
+        saveCache(cache.get(), img);
+        searchIncrementally(img, mask, isMask, matchPercent, tolerance, opts);
+        writeImage(img, outImageFile);
+        return;
+    }
     // The following matched-rectangle-list holds the list of rectangular
     // regions in the image that have already been matched.
     MatchedRectList mrl;
-    const int maxRow = img.getHeight() - mask.getHeight();
-    const int maxCol = img.getWidth()  - mask.getWidth();
-    const int pixMatchNeeded = mask.getBufferSize() * matchPercent / 400;
+    // The mask resized to each of the scales to be searched (just the
+    // mask as-is by default) along with the kernel specialized for the
+    // metric, channels, and mask mode.
+    const int maxLevel = opts.scales.empty() ? 0 : opts.pyramidLevels;
+    std::vector<std::unique_ptr<ScaleSearch>> scales;
+    int maxRow = -1, maxCol = -1, maxMaskHeight = 0, pyramidLevel = 0;
+    for (const double scale : (opts.scales.empty() ? std::vector<double>{1}
+                               : opts.scales)) {
+        scales.push_back(std::make_unique<ScaleSearch>(mask, scale, isMask,
+            opts.metric, opts.channels, matchPercent, tolerance, maxLevel,
+            opts.pyramidSlack, opts.layout.stripWidth));
+        const PNG& scaledMask = scales.back()->getMask();
+        maxRow = std::max(maxRow, img.getHeight() - scaledMask.getHeight());
+        maxCol = std::max(maxCol, img.getWidth()  - scaledMask.getWidth());
+        maxMaskHeight = std::max(maxMaskHeight, scaledMask.getHeight());
+        pyramidLevel  = std::max(pyramidLevel, scales.back()->getLevel());
+        if (opts.cascadeSamples > 0) {
+            scales.back()->setCascade(opts.cascadeSamples, opts.cascadeMargin);
+        }
+    }
+    // Screen windows for each scale on coarse levels of the image
+    // pyramid. The levels are shared by all the scales.
+    ImagePyramid pyramid(img, cache.get());
+    // Sub-images are (optionally) scored or bounded with an SSD map. The
+    // bound on the SAD is loose, so it is only used if requested.
+    const auto wantsSSDMap = [&](const std::unique_ptr<ScaleSearch>& scale) {
+        return !isMask && ((opts.metric == ScoreMetric::Tolerance) ||
+                           (opts.metric == ScoreMetric::SSD) ||
+                           ((opts.metric == ScoreMetric::SAD) &&
+                            (opts.fftMode == SSDMap::On))) &&
+            SSDMap::isUsed(opts.fftMode, img, scale->getMask());
+    };
+    const bool useSSDMap = std::any_of(scales.begin(), scales.end(),
+                                       wantsSSDMap);
+    if ((pyramidLevel > 0) || useSSDMap) {
+        // Screening and SSD maps need the whole image (and screening
+        // needs exclusive use of the cache).
+        producer.join();
+        progress.rethrow();
+    }
+    if (useSSDMap) {
+        for (auto& scale : scales) {
+            if (wantsSSDMap(scale)) {
+                scale->setSSDMap(std::make_shared<SSDMap>(img,
+                    scale->getMask(), opts.channels));
+            }
+        }
+    }
+    if (pyramidLevel > 0) {
+        pyramid.build(pyramidLevel);
+        for (auto& scale : scales) {
+            scale->prepare(pyramid);
+        }
+    }
+    // Use the layout for the search. The threads must be set before the
+    // tracer is created, as it has a buffer per thread.
+    if (opts.layout.threads > 0) {
+        omp_set_num_threads(opts.layout.threads);
+    }
+    omp_set_schedule(opts.layout.schedule, opts.layout.chunkSize);
+    // Setup the optional tracer to log the windows that are scored.
+    std::unique_ptr<Tracer> tracer;
+    if (!opts.traceFile.empty()) {
+        TraceHeader hdr{};
+        hdr.imgWidth   = img.getWidth();
+        hdr.imgHeight  = img.getHeight();
+        hdr.maskWidth  = scales.front()->getMask().getWidth();
+        hdr.maskHeight = scales.front()->getMask().getHeight();
+        hdr.tolerance  = tolerance;
+        hdr.matchPercent = matchPercent;
+        hdr.isMask     = isMask;
+        hdr.metric     = static_cast<int>(opts.metric);
+        hdr.sampleRate = opts.traceSample;
+        hdr.threshold  = scales.front()->getKernel().getThreshold();
+        const MatchedRect& roi = opts.traceRoi;
+        const bool hasRoi = (roi.row2 > roi.row1) && (roi.col2 > roi.col1);
+        hdr.roi[0] = hasRoi ? roi.row1 : 0;
+        hdr.roi[1] = hasRoi ? roi.col1 : 0;
+        hdr.roi[2] = hasRoi ? roi.row2 : img.getHeight();
+        hdr.roi[3] = hasRoi ? roi.col2 : img.getWidth();
+        tracer = std::make_unique<Tracer>(opts.traceFile, hdr, mainImageFile,
+                                          maskImageFile);
+    }
+    // The stream that reports matches (possibly as they are found) and
+    // tracks when the maximum number of matches have been reported.
+    MatchStream stream(std::cout, maxRow + 1, opts.streamMode,
+                       opts.maxMatches);
+    // Flag set when the search ran out of time. Remaining iterations of
+    // the parallel loop check this flag and do nothing.
+    std::atomic<bool> timedOut{false};
+    const auto shouldStop = [&]() {
+        if (stream.isDone() || timedOut.load(std::memory_order_relaxed)) {
+            return true;
+        }
+        if ((opts.timeBudget > 0) && (Clock::now() >= deadline)) {
+            timedOut = true;
+        }
+        return timedOut.load(std::memory_order_relaxed);
+    };
     // Multi-threaded searching image row-by-row and column-by-column 
-    // boxing out matching regions
-#pragma omp parallel for default(shared)
+    // boxing out matching regions. Rows are handed out in order so that
+    // the threads can follow the rows being decoded.
+    const int stripStride = std::max(opts.layout.stripWidth, 1);
+#pragma omp parallel for default(shared) schedule(runtime)
     for (int row = 0; (row <= maxRow); row++) {
+        // Wait for all the rows needed by windows starting at this row.
+        if (shouldStop() || !progress.waitFor(std::min(img.getHeight(),
+                                                       row + maxMaskHeight))) {
+            continue;  // Stopped early or decoding failed (reported below)
+        }
+        bool rowComplete = true;
+        // Scores of the regions in the current strip computed together.
+        std::vector<RegionScore> stripScores(scales.size() * stripStride);
         for (int col = 0; (col <= maxCol); col++) {
-            // Create a rectangle representing the region we are going to 
-            // check for a matching image.
-            const MatchedRect srchRegion(row, col,
-                std::min(img.getWidth()  - col, mask.getWidth()),
-                std::min(img.getHeight() - row, mask.getHeight()));
-            // Use an helper method to perform the check.
-            checkMatchRegion(img, mask, mrl, srchRegion, pixMatchNeeded, 
-                            tolerance);
+            if (((col & 31) == 0) && shouldStop()) {
+                rowComplete = false;
+                break;
+            }
+            const int stripCol = col % stripStride;
+            if ((opts.layout.stripWidth > 0) && (stripCol == 0)) {
+                scoreStrips(img, scales, mrl, row, col, tracer != NULL,
+                            stripScores);
+            }
+            // Try the scales from largest to smallest. A match at any
+            // scale suppresses overlapping windows at all the scales.
+            for (size_t s = 0; (s < scales.size()); s++) {
+                const auto& scale = scales[s];
+                const PNG& scaledMask = scale->getMask();
+                if ((row + scaledMask.getHeight() > img.getHeight()) ||
+                    (col + scaledMask.getWidth()  > img.getWidth())  ||
+                    !scale->screen(row, col)) {
+                    continue;  // Does not fit or was screened out
+                }
+                // Create a rectangle representing the region we are going
+                // to check for a matching image.
+                const MatchedRect srchRegion(row, col, scaledMask.getWidth(),
+                                             scaledMask.getHeight());
+                // Use an helper method to perform the check.
+                const RegionScore& preScore =
+                    stripScores[s * stripStride + stripCol];
+                if (checkMatchRegion(img, scale->getKernel(), mrl, srchRegion,
+                                     tracer.get(), &preScore)) {
+                    stream.add(srchRegion);
+                    break;
+                }
+            }
         }
+        if (rowComplete) {
+            stream.rowDone(row);
+        }
+    }
+    if (producer.joinable()) {
+        producer.join();
     }
+    progress.rethrow();
+    // Save the sidecar (with any pyramid levels) before boxes are drawn.
+    saveCache(cache.get(), img);
     // Finally, print some result and write out result image
-    processResult(mrl, img);
-    std::cout << "Number of matches: " << mrl.size() << std::endl;
-    img.write(outImageFile);
+    const MatchedRectList matches = stream.finish();
+    processResult(matches, img, !stream.isStreaming());
+    std::cout << "Number of matches: " << matches.size() << std::endl;
+    if (opts.cascadeSamples > 0) {
+        // Report the windows rejected by the cascade at all the scales.
+        uint64_t tested = 0, passed = 0;
+        for (const auto& scale : scales) {
+            uint64_t scaleTested, scalePassed;
+            scale->getKernel().getCascadeStats(scaleTested, scalePassed);
+            tested += scaleTested;
+            passed += scalePassed;
+        }
+        std::cout << "Cascade prefilter rejected " << (tested - passed)
+                  << " of " << tested << " windows ("
+                  << (tested ? (tested - passed) * 100.0 / tested : 0)
+                  << "%)" << std::endl;
+    }
+    if (stream.isDone() || timedOut) {
+        // Report the portion of the image that was searched.
+        const int numRows = std::max(maxRow + 1, 0);
+        std::cout << "Search stopped early ("
+                  << (timedOut ? "time budget exceeded" : "max matches found")
+                  << "): searched " << stream.getRowsDone() << " of "
+                  << numRows << " rows ("
+                  << (numRows ? stream.getRowsDone() * 100.0 / numRows : 100)
+                  << "%)" << std::endl;
+    }
+    writeImage(img, outImageFile);
 }
 
 /**
@@ -302,22 +757,187 @@ void imageSearch(const std::string& mainImageFile,
  *    5. Optional: Number indicating required percentage of pixels to match
  *       (default is 75)
  *    6. Optiona: A tolerance value to be specified (default: 32)
+ * Instead of PNG files, the images may be raw pixels given as
+ * raw:WxH:rgba|rgb|gray:path, or Netpbm files given as ppm:path,
+ * pgm:path, pam:path (or paths ending in .ppm, .pgm, .pam). A path of
+ * "-" is the standard input or output. If the output image is written
+ * to the standard output, the results are printed to standard error.
+ * In addition, the following options (in the form --name=value) can be
+ * specified anywhere on the command-line:
+ *    --huge-pages=none|thp|explicit: Huge page backing for image buffers
+ *      (default: thp)
+ *    --cache[=dir]: Load the main image from (and save it to) a sidecar
+ *      file, stored in the given directory or alongside the image.
+ *    --metric=tolerance|sad|ssd|ncc: The metric used to score each region
+ *      (default: tolerance)
+ *    --fft=auto|on|off: Compute the SSD of all the regions with FFTs, to
+ *      score (ssd) or reject (tolerance and sad) regions when searching for
+ *      a sub-image. auto uses FFTs for sub-images of at least 256 pixels,
+ *      except with sad (default: auto)
+ *    --channels=1|3: Number of color channels to be compared. Use 1 for
+ *      grayscale images (default: 3)
+ *    --trace=file: Log the regions scored to the given binary trace file
+ *    --trace-sample=N: Trace only 1 out of N regions (default: 1)
+ *    --trace-roi=row1,col1,row2,col2: Trace only regions whose top-left
+ *      corner is in the given region of interest
+ *    --stream[=ordered]: Print matches as they are found, optionally in
+ *      row-major order
+ *    --max-matches=N: Stop the search once N matches have been reported
+ *    --time-budget=secs: Stop the search after the given wall-clock time
+ *    --scales=min:max:step|s1,s2,...: Search for the mask resized to each
+ *      of the given scales
+ *    --pyramid-levels=N: Highest level of the image pyramid on which
+ *      windows are screened in a multi-scale search (default: 2)
+ *    --pyramid-slack=N: Amount by which match-percentage is lowered when
+ *      screening windows (default: 10)
+ *    --strip-width=0|8|16: Number of adjacent windows scored together by
+ *      the register-blocked kernels. 0 scores windows one at a time
+ *      (default: 16)
+ *    --cascade[=N]: Prefilter windows on a stratified subset of N mask
+ *      pixels before scoring all the pixels (default N: 64)
+ *    --cascade-margin=N: Amount by which match-percentage is lowered for
+ *      the cascade prefilter (default: 25)
+ *    --threads=N: Number of threads (default: OpenMP default)
+ *    --schedule=static|dynamic|guided[,chunk]: Schedule used to distribute
+ *      rows to threads (default: dynamic,1)
+ *    --tune: Calibrate the threads, schedule, and strip width on sample
+ *      rows and store them in the tuning profile
+ *    --profile=file|none: The tuning profile from which the layout is
+ *      loaded unless --threads, --schedule, or --strip-width are specified
+ *      (default: ~/.imagesearch.profile)
+ *    --sweep-percent=min:max:step|p1,p2,...: Report the matches for each
+ *      of the given match-percentages (and tolerances) instead of
+ *      searching with a single match-percentage
+ *    --sweep-tolerance=min:max:step|t1,t2,...: Report the matches for each
+ *      of the given tolerances (and match-percentages)
+ *    --state=file: Persist the scores of all windows in the given file and
+ *      only score the windows in changed regions of the image when it is
+ *      searched again
  */
 int main(int argc, char *argv[]) {
-    if (argc < 4) {
+    // Separate the "--name=value" options from the positional arguments.
+    std::vector<std::string> args;
+    std::unordered_map<std::string, std::string> options;
+    for (int i = 0; (i < argc); i++) {
+        const std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") == 0) {
+            const size_t eqPos = arg.find('=');
+            options[arg.substr(2, eqPos - 2)] = 
+                (eqPos == std::string::npos) ? "" : arg.substr(eqPos + 1);
+        } else {
+            args.push_back(arg);
+        }
+    }
+    if (args.size() < 4) {
         // Insufficient number of required parameters.
         std::cout << "Usage: " << argv[0] << " <MainPNGfile> <SearchPNGfile> "
                   << "<OutputPNGfile> [isMaskFlag] [match-percentage] "
-                  << "[tolerance]\n";
+                  << "[tolerance] [--huge-pages=none|thp|explicit] "
+                  << "[--cache[=dir]] [--metric=tolerance|sad|ssd|ncc] "
+                  << "[--fft=auto|on|off] "
+                  << "[--channels=1|3] [--trace=file] [--trace-sample=N] "
+                  << "[--trace-roi=row1,col1,row2,col2] [--stream[=ordered]] "
+                  << "[--max-matches=N] [--time-budget=secs] "
+                  << "[--scales=min:max:step|s1,s2,...] [--pyramid-levels=N] "
+                  << "[--pyramid-slack=N] [--strip-width=0|8|16] "
+                  << "[--threads=N] [--schedule=kind[,chunk]] [--tune] "
+                  << "[--profile=file|none] [--cascade[=N]] "
+                  << "[--cascade-margin=N] [--sweep-percent=p1,p2,...] "
+                  << "[--sweep-tolerance=t1,t2,...] [--state=file]\n";
         return 1;
     }
+    if (RawImage::isRaw(args[3]) && RawImage::isStdio(args[3])) {
+        // Keep the standard output for the output image.
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+    if (options.count("huge-pages")) {
+        PixelBufferPolicy::setHugePages(options["huge-pages"]);
+    }
+    SearchOptions opts;
+    opts.useCache = (options.count("cache") > 0);
+    opts.cacheDir = options["cache"];
+    if (options.count("metric")) {
+        opts.metric = SearchKernel::toMetric(options["metric"]);
+    }
+    if (options.count("fft")) {
+        opts.fftMode = SSDMap::toMode(options["fft"]);
+    }
+    if (options.count("channels")) {
+        opts.channels = std::stoi(options["channels"]);
+    }
+    opts.traceFile = options["trace"];
+    if (options.count("trace-sample")) {
+        opts.traceSample = std::stoi(options["trace-sample"]);
+    }
+    if (options.count("trace-roi")) {
+        // The region of interest is specified as row1,col1,row2,col2
+        std::istringstream is(options["trace-roi"]);
+        MatchedRect& roi = opts.traceRoi;
+        char comma;
+        is >> roi.row1 >> comma >> roi.col1 >> comma >> roi.row2 >> comma
+           >> roi.col2;
+    }
+    if (options.count("stream")) {
+        opts.streamMode = (options["stream"] == "ordered") ?
+            MatchStream::Ordered : MatchStream::Stream;
+    }
+    if (options.count("max-matches")) {
+        opts.maxMatches = std::stoul(options["max-matches"]);
+    }
+    if (options.count("time-budget")) {
+        opts.timeBudget = std::stod(options["time-budget"]);
+    }
+    if (options.count("scales")) {
+        opts.scales = ScaleSearch::parseScales(options["scales"]);
+    }
+    if (options.count("pyramid-levels")) {
+        opts.pyramidLevels = std::stoi(options["pyramid-levels"]);
+    }
+    if (options.count("strip-width")) {
+        opts.layout.stripWidth = std::stoi(options["strip-width"]);
+    }
+    if (options.count("cascade")) {
+        opts.cascadeSamples = options["cascade"].empty() ? 64 :
+            std::stoi(options["cascade"]);
+    }
+    if (options.count("cascade-margin")) {
+        opts.cascadeMargin = std::stoi(options["cascade-margin"]);
+    }
+    if (options.count("threads")) {
+        opts.layout.threads = std::stoi(options["threads"]);
+    }
+    if (options.count("schedule")) {
+        opts.layout.setSchedule(options["schedule"]);
+    }
+    // A tuned layout is not used if the layout is given explicitly.
+    opts.tune = (options.count("tune") > 0);
+    const bool hasLayout = options.count("threads") ||
+        options.count("schedule") || options.count("strip-width");
+    opts.profileFile = options.count("profile") ? options["profile"] :
+        TuneProfile::defaultPath();
+    if ((opts.profileFile == "none") || (hasLayout && !opts.tune)) {
+        opts.profileFile.clear();
+    }
+    if (options.count("pyramid-slack")) {
+        opts.pyramidSlack = std::stoi(options["pyramid-slack"]);
+    }
+    if (options.count("sweep-percent")) {
+        opts.sweepPercents =
+            ParameterSweep::parseList(options["sweep-percent"]);
+    }
+    if (options.count("sweep-tolerance")) {
+        opts.sweepTolerances =
+            ParameterSweep::parseList(options["sweep-tolerance"]);
+    }
+    opts.stateFile = options["state"];
     const std::string True("true");
     // Call the method that starts off the image search with the necessary
     // parameters.
-    imageSearch(argv[1], argv[2], argv[3],       // The 3 required PNG files
-        (argc > 4 ? (True == argv[4]) : true),   // Optional mask flag
-        (argc > 5 ? std::stoi(argv[5]) : 75),    // Optional percentMatch
-        (argc > 6 ? std::stoi(argv[6]) : 32));   // Optional tolerance
+    imageSearch(args[1], args[2], args[3],             // The 3 required PNGs
+        (args.size() > 4 ? (True == args[4]) : true),  // Optional mask flag
+        (args.size() > 5 ? std::stoi(args[5]) : 75),   // Optional percentMatch
+        (args.size() > 6 ? std::stoi(args[6]) : 32),   // Optional tolerance
+        opts);
 
     return 0;
 }
@@ -0,0 +1,70 @@
+#!/bin/bash
+# Regression test for two matches that are one column apart. The right
+# edge of the box around a match is drawn one column outside the match
+# (on column col2). This test checks that both matches are found and
+# that both boxes are drawn, with the gap column holding the right edge
+# of the first box.
+#
+# Usage: tests/AdjacentMatches.sh <search-binary>
+
+if [ $# -lt 1 ]; then
+    echo "Usage: $0 <search-binary>"
+    exit 1
+fi
+search="$1"
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+# A 5 x 4 checkerboard sub-image (gray pixels).
+pattern() {
+    for ((r = 0; r < 4; r++)); do
+        for ((c = 0; c < 5; c++)); do
+            if (( (r + c) % 2 )); then printf '\377'; else printf '\000'; fi
+        done
+    done
+}
+pattern > "$dir/sub.gray"
+
+# A 20 x 6 gray image with the sub-image at (1, 2) and (1, 8), that is,
+# the columns 2-6 and 8-12 leaving column 7 between them.
+for ((r = 0; r < 6; r++)); do
+    for ((c = 0; c < 20; c++)); do
+        if (( r >= 1 && r <= 4 && ((c >= 2 && c <= 6) || (c >= 8 && c <= 12)) ))
+        then
+            (( (r - 1 + c - (c >= 8 ? 8 : 2)) % 2 )) && printf '\377' ||
+                printf '\000'
+        else
+            printf '\200'
+        fi
+    done
+done > "$dir/img.gray"
+
+"$search" raw:20x6:gray:"$dir/img.gray" raw:5x4:gray:"$dir/sub.gray" \
+    raw:20x6:rgba:"$dir/out.rgba" false 95 1 --threads=1 > "$dir/out.txt"
+expected="sub-image matched at: 1, 2, 5, 7
+sub-image matched at: 1, 8, 5, 13
+Number of matches: 2"
+if [ "$(cat "$dir/out.txt")" != "$expected" ]; then
+    echo "FAIL: unexpected matches:"
+    cat "$dir/out.txt"
+    exit 2
+fi
+
+# The color (r g b a) of the pixel at the given row and column.
+pixel() {
+    od -An -tu1 -j $(( ($1 * 20 + $2) * 4 )) -N4 "$dir/out.rgba" | xargs
+}
+for ((r = 1; r < 5; r++)); do
+    for c in 2 7 8 13; do
+        if [ "$(pixel $r $c)" != "255 0 0 255" ]; then
+            echo "FAIL: pixel ($r, $c) is not red: $(pixel $r $c)"
+            exit 3
+        fi
+    done
+done
+# Interior pixels of the matches are not changed.
+if [ "$(pixel 2 9)" != "0 0 0 255" ]; then
+    echo "FAIL: pixel (2, 9) was changed: $(pixel 2 9)"
+    exit 3
+fi
+echo "PASS"
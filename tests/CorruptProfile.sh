@@ -0,0 +1,61 @@
+#!/bin/bash
+# Regression test for bad entries in the tuning profile. The profile
+# (~/.imagesearch.profile) is read on every search, so a bad entry must
+# be skipped with a warning instead of aborting the search. The search
+# is run with a temporary HOME holding a profile with bad entries,
+# including one for the key of the searched images.
+#
+# Usage: tests/CorruptProfile.sh <search-binary>
+
+if [ $# -lt 1 ]; then
+    echo "Usage: $0 <search-binary>"
+    exit 1
+fi
+search="$1"
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+# A 20 x 6 gray image with a 5 x 4 checkerboard sub-image at (1, 2).
+for ((r = 0; r < 4; r++)); do
+    for ((c = 0; c < 5; c++)); do
+        if (( (r + c) % 2 )); then printf '\377'; else printf '\000'; fi
+    done
+done > "$dir/sub.gray"
+for ((r = 0; r < 6; r++)); do
+    for ((c = 0; c < 20; c++)); do
+        if (( r >= 1 && r <= 4 && c >= 2 && c <= 6 )); then
+            (( (r - 1 + c - 2) % 2 )) && printf '\377' || printf '\000'
+        else
+            printf '\200'
+        fi
+    done
+done > "$dir/img.gray"
+
+# The key of the profile entry for the searched images.
+cpu=$(grep -m1 '^model name' /proc/cpuinfo | sed 's/^[^:]*:[ \t]*//')
+key="${cpu:-unknown} ($(getconf _NPROCESSORS_ONLN) cpus) 20x6 5x4"
+printf '%s\t%s\n' "garbage" "2 bogus 16" "other" "2 static,x 16" \
+    "$key" "1 static,0 4" "$key" "0 dynamic,1 8" > "$dir/.imagesearch.profile"
+
+HOME="$dir" "$search" raw:20x6:gray:"$dir/img.gray" \
+    raw:5x4:gray:"$dir/sub.gray" raw:20x6:rgba:"$dir/out.rgba" false 95 1 \
+    > "$dir/out.txt" 2> "$dir/err.txt"
+rc=$?
+if [ $rc -ne 0 ]; then
+    echo "FAIL: search exited with $rc:"
+    cat "$dir/err.txt"
+    exit 2
+fi
+expected="sub-image matched at: 1, 2, 5, 7
+Number of matches: 1"
+if [ "$(cat "$dir/out.txt")" != "$expected" ]; then
+    echo "FAIL: unexpected matches:"
+    cat "$dir/out.txt"
+    exit 3
+fi
+if [ "$(grep -c '^Warning: skipping line' "$dir/err.txt")" -ne 4 ]; then
+    echo "FAIL: expected a warning for each of the 4 bad entries:"
+    cat "$dir/err.txt"
+    exit 4
+fi
+echo "PASS"
@@ -0,0 +1,133 @@
+#!/bin/bash
+# Strong- and weak-scaling sweeps of the image search over thread counts,
+# on synthetic images with masks planted at known locations (generated by
+# tools/SyntheticImage.cpp). For each thread count, the wall-clock time,
+# speedup, parallel efficiency, and the recall of the planted masks are
+# reported. A planted mask is recalled if a match starts within 2 pixels
+# of it.
+#
+# Usage: tools/ScalingSweep.sh <search-binary> <SyntheticImage-binary>
+#            <MaskPNGfile> [--name=value ...]
+# Options:
+#   --width=N, --height=N: Size of the image for 1 thread (default: 4000 x
+#     2000). For weak scaling, the height (and count) grow with threads.
+#   --threads="1 2 4 8": Thread counts to be measured
+#   --mode=strong|weak|both: Sweeps to be run (default: both)
+#   --count=N: Number of masks planted per 1-thread image (default: 20)
+#   --mask=true|false: Search for a mask or a sub-image (default: true)
+#   --percent=N, --tolerance=N: Search parameters (default: 75, 32)
+#   --noise=S, --jitter=N, --tile=N, --seed=N: See SyntheticImage
+#   --search-opts="...": Additional options passed to the search
+#   --workdir=dir: Directory for images and outputs (default: /tmp/scaling)
+
+if [ $# -lt 3 ]; then
+    grep '^# Usage' -A 18 "$0" | cut -c 3-
+    exit 1
+fi
+search=$1
+generator=$2
+mask=$3
+shift 3
+
+width=4000; height=2000; threads="1 2 4 8"; mode=both; count=20
+isMask=true; percent=75; tolerance=32; noise=0; jitter=8; tile=1; seed=1
+searchOpts=""; workdir=/tmp/scaling
+for arg in "$@"; do
+    value=${arg#*=}
+    case $arg in
+        --width=*)       width=$value ;;
+        --height=*)      height=$value ;;
+        --threads=*)     threads=$value ;;
+        --mode=*)        mode=$value ;;
+        --count=*)       count=$value ;;
+        --mask=*)        isMask=$value ;;
+        --percent=*)     percent=$value ;;
+        --tolerance=*)   tolerance=$value ;;
+        --noise=*)       noise=$value ;;
+        --jitter=*)      jitter=$value ;;
+        --tile=*)        tile=$value ;;
+        --seed=*)        seed=$value ;;
+        --search-opts=*) searchOpts=$value ;;
+        --workdir=*)     workdir=$value ;;
+        *) echo "Unknown option: $arg" >&2; exit 1 ;;
+    esac
+done
+mkdir -p "$workdir" || exit 2
+
+# Generate an image (if it does not already exist) of the given size.
+# Arguments: image file, height, number of masks.
+generate() {
+    if [ ! -f "$1" ] || [ ! -f "$1.truth" ]; then
+        "$generator" "$mask" "$1" "$width" "$2" --count="$3" \
+            --mask="$isMask" --noise="$noise" --jitter="$jitter" \
+            --tile="$tile" --seed="$seed" > /dev/null || exit 3
+    fi
+}
+
+# Run the search and print the time, number of matches, and recall. This
+# is run in a subshell (via $(...)), so a failure is reported by the exit
+# status, which the caller must check.
+# Arguments: image file, number of threads.
+measure() {
+    local out="$workdir/result_$2.txt"
+    local start end
+    start=$(date +%s.%N)
+    "$search" "$1" "$mask" "$workdir/result.png" "$isMask" "$percent" \
+        "$tolerance" --threads="$2" $searchOpts > "$out" || exit 4
+    end=$(date +%s.%N)
+    awk -v start="$start" -v end="$end" '
+        FNR == NR { if ($0 !~ /^#/) { row[++n] = $1; col[n] = $2 }; next }
+        /^sub-image matched at:/ {
+            gsub(",", ""); mrow[++m] = $4; mcol[m] = $5 }
+        END {
+            found = 0
+            for (i = 1; i <= n; i++) {
+                for (j = 1; j <= m; j++) {
+                    if ((row[i] - mrow[j])^2 <= 4 &&
+                        (col[i] - mcol[j])^2 <= 4) {
+                        found++; break
+                    }
+                }
+            }
+            printf "%.3f %d %.3f\n", end - start, m, (n ? found / n : 1)
+        }' "$1.truth" "$out"
+}
+
+if [ "$mode" != weak ]; then
+    image="$workdir/strong_${width}x${height}.png"
+    generate "$image" "$height" "$count"
+    echo "Strong scaling: $width x $height image, $count planted masks"
+    printf "Threads\tTime(s)\tSpeedup\tEfficiency\tMatches\tRecall\n"
+    # The speedup is relative to the first thread count (normally 1), with
+    # perfect scaling up to that count assumed.
+    base=""
+    for t in $threads; do
+        result=$(measure "$image" "$t") ||
+            { echo "Error: search of $image with $t threads failed" >&2;
+              exit 4; }
+        read -r time matches recall <<< "$result"
+        base=${base:-$(awk -v t="$time" -v p="$t" 'BEGIN { print t * p }')}
+        awk -v p="$t" -v t="$time" -v b="$base" -v m="$matches" \
+            -v r="$recall" 'BEGIN { printf "%d\t%.2f\t%.2f\t%.2f\t%d\t%.3f\n",
+                                    p, t, b / t, b / t / p, m, r }'
+    done
+fi
+
+if [ "$mode" != strong ]; then
+    echo "Weak scaling: $width x ($height * threads) image, $count planted" \
+         "masks per thread"
+    printf "Threads\tHeight\tTime(s)\tEfficiency\tMatches\tRecall\n"
+    base=""
+    for t in $threads; do
+        image="$workdir/weak_${width}x$((height * t)).png"
+        generate "$image" $((height * t)) $((count * t))
+        result=$(measure "$image" "$t") ||
+            { echo "Error: search of $image with $t threads failed" >&2;
+              exit 4; }
+        read -r time matches recall <<< "$result"
+        base=${base:-$time}
+        awk -v p="$t" -v h=$((height * t)) -v t="$time" -v b="$base" \
+            -v m="$matches" -v r="$recall" 'BEGIN {
+                printf "%d\t%d\t%.2f\t%.2f\t%d\t%.3f\n", p, h, t, b / t, m, r }'
+    done
+fi
@@ -0,0 +1,261 @@
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+// A small program to synthesize test images of arbitrary size for
+// scaling experiments. A mask (or sub-image) is planted at random,
+// non-overlapping locations in a noisy background, and the locations
+// are written to a ground-truth file that tools/ScalingSweep.sh uses
+// to compute the recall of the search. Build from the top-level
+// directory with:
+//
+//   g++ -std=c++17 -O2 -I. tools/SyntheticImage.cpp PNG.cpp MappedFile.cpp
+//       -o SyntheticImage -lpng
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include "PNG.h"
+#include "MatchedRect.h"
+
+// It is ok to use the following namespace delarations in C++ source
+// files only. They must never be used in header files.
+using namespace std;
+
+/**
+ * The settings (specified as --name=value arguments) that control how
+ * the image is synthesized.
+ */
+struct Settings {
+    /** The number of copies of the mask that are planted. */
+    int count = 10;
+    /** Flag to indicate if the mask is a black-and-white mask. */
+    bool isMask = true;
+    /** The maximum amount by which each channel of a planted pixel is
+        perturbed. This should be well below the search tolerance. */
+    int jitter = 8;
+    /** Standard deviation of the Gaussian noise added to all pixels. */
+    double noise = 0;
+    /** The size of the square tiles of random color in the background. */
+    int tile = 1;
+    /** The seed for the random number generator. */
+    unsigned int seed = 1;
+    /** The file to which the planted locations are written. */
+    std::string truthFile;
+};
+
+/**
+ * Helper method to clamp a value to the range of a color channel.
+ */
+unsigned char clampChannel(const double value) {
+    return std::min(255.0, std::max(0.0, std::round(value)));
+}
+
+/**
+ * Fill the image with square tiles of uniformly random colors.
+ */
+void fillBackground(PNG& img, const Settings& set, std::mt19937& rng) {
+    std::uniform_int_distribution<int> color(0, 255);
+    const int tilesPerRow = (img.getWidth() + set.tile - 1) / set.tile;
+    std::vector<unsigned char> tiles(tilesPerRow * 4);
+    for (int row = 0; (row < img.getHeight()); row++) {
+        if ((row % set.tile) == 0) {
+            std::generate(tiles.begin(), tiles.end(),
+                          [&]{ return color(rng); });
+        }
+        unsigned char* pix = img.getPixels() + size_t(row) * img.getWidth() * 4;
+        for (int col = 0; (col < img.getWidth()); col++, pix += 4) {
+            std::copy_n(&tiles[(col / set.tile) * 4], 3, pix);
+            pix[3] = 255;
+        }
+    }
+}
+
+/**
+ * Choose random locations for the planted masks such that no two of
+ * them are considered to overlap by the search. Fewer locations are
+ * returned if the image is too crowded.
+ */
+MatchedRectList chooseLocations(const PNG& img, const PNG& mask,
+                                const Settings& set, std::mt19937& rng) {
+    MatchedRectList rects;
+    const int maxRow = img.getHeight() - mask.getHeight();
+    const int maxCol = img.getWidth()  - mask.getWidth();
+    if ((maxRow < 0) || (maxCol < 0)) {
+        return rects;
+    }
+    std::uniform_int_distribution<int> rowDist(0, maxRow), colDist(0, maxCol);
+    for (int tries = 0; (int(rects.size()) < set.count) &&
+             (tries < set.count * 100); tries++) {
+        const MatchedRect rect(rowDist(rng), colDist(rng), mask.getWidth(),
+                               mask.getHeight());
+        // Leave a margin so that the search's windows near one planted
+        // mask do not overlap a neighboring one.
+        const MatchedRect padded(rect.row1 - 2, rect.col1 - 2,
+                                 mask.getWidth() + 4, mask.getHeight() + 4);
+        if (!rects.isMatched(padded)) {
+            rects.push_back(rect);
+        }
+    }
+    std::sort(rects.begin(), rects.end());
+    return rects;
+}
+
+/**
+ * Plant a copy of the mask at the given location. For a black-and-white
+ * mask, the black pixels are replaced by a random color and the others
+ * by a contrasting color. A sub-image is copied as-is. In both cases,
+ * each channel is then perturbed by up to set.jitter.
+ */
+void plant(PNG& img, const PNG& mask, const MatchedRect& rect,
+           const Settings& set, std::mt19937& rng) {
+    std::uniform_int_distribution<int> color(0, 255);
+    std::uniform_int_distribution<int> jitter(-set.jitter, set.jitter);
+    unsigned char bg[3], fg[3];
+    for (int c = 0; (c < 3); c++) {
+        bg[c] = color(rng);
+        fg[c] = (bg[c] + 128) % 256;  // Differs by at least 127
+    }
+    const Pixel Black{ .rgba = 0xff'00'00'00U };
+    for (int row = 0; (row < mask.getHeight()); row++) {
+        for (int col = 0; (col < mask.getWidth()); col++) {
+            const Pixel mpix = mask.getPixel(row, col);
+            const unsigned char* src = set.isMask ?
+                ((mpix.rgba == Black.rgba) ? bg : fg) : &mpix.color.red;
+            unsigned char* dst = img.getPixels() + (size_t(rect.row1 + row) *
+                img.getWidth() + rect.col1 + col) * 4;
+            for (int c = 0; (c < 3); c++) {
+                dst[c] = clampChannel(src[c] + jitter(rng));
+            }
+        }
+    }
+}
+
+/**
+ * Add Gaussian noise with the given standard deviation to all pixels.
+ */
+void addNoise(PNG& img, const double stdDev, std::mt19937& rng) {
+    std::normal_distribution<double> noise(0, stdDev);
+    unsigned char* pix = img.getPixels();
+    for (size_t i = 0; (i < size_t(img.getWidth()) * img.getHeight());
+         i++, pix += 4) {
+        for (int c = 0; (c < 3); c++) {
+            pix[c] = clampChannel(pix[c] + noise(rng));
+        }
+    }
+}
+
+/**
+ * The main method that synthesizes the image and the ground truth.
+ *
+ * \param[in] argv The command-line arguments:
+ *    1. The mask (or sub-image) PNG file to be planted.
+ *    2. The PNG file to which the image is written.
+ *    3. The width of the image.
+ *    4. The height of the image.
+ * In addition, the following options (in the form --name=value) can be
+ * specified anywhere on the command-line:
+ *    --count=N: Number of copies of the mask planted (default: 10)
+ *    --mask=true|false: Plant a black-and-white mask or copy a sub-image
+ *      (default: true)
+ *    --jitter=N: Maximum perturbation of each channel of planted pixels
+ *      (default: 8)
+ *    --noise=S: Standard deviation of Gaussian noise added to all pixels
+ *      (default: 0)
+ *    --tile=N: Size of the tiles of random color in the background
+ *      (default: 1)
+ *    --seed=N: Seed for the random number generator (default: 1)
+ *    --truth=file: File to which the planted locations are written
+ *      (default: the output file with .truth appended)
+ */
+int main(int argc, char *argv[]) {
+    std::vector<std::string> args;
+    std::unordered_map<std::string, std::string> options;
+    for (int i = 0; (i < argc); i++) {
+        const std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") == 0) {
+            const size_t eqPos = arg.find('=');
+            options[arg.substr(2, eqPos - 2)] =
+                (eqPos == std::string::npos) ? "" : arg.substr(eqPos + 1);
+        } else {
+            args.push_back(arg);
+        }
+    }
+    if (args.size() < 5) {
+        std::cout << "Usage: " << argv[0] << " <MaskPNGfile> <OutputPNGfile> "
+                  << "<width> <height> [--count=N] [--mask=true|false] "
+                  << "[--jitter=N] [--noise=S] [--tile=N] [--seed=N] "
+                  << "[--truth=file]\n";
+        return 1;
+    }
+    Settings set;
+    if (options.count("count")) {
+        set.count = std::stoi(options["count"]);
+    }
+    set.isMask = (options.count("mask") == 0) || (options["mask"] == "true");
+    if (options.count("jitter")) {
+        set.jitter = std::stoi(options["jitter"]);
+    }
+    if (options.count("noise")) {
+        set.noise = std::stod(options["noise"]);
+    }
+    if (options.count("tile")) {
+        set.tile = std::max(1, std::stoi(options["tile"]));
+    }
+    if (options.count("seed")) {
+        set.seed = std::stoul(options["seed"]);
+    }
+    set.truthFile = options.count("truth") ? options["truth"] :
+        (args[2] + ".truth");
+
+    PNG mask, img;
+    mask.load(args[1]);
+    img.create(std::stoi(args[3]), std::stoi(args[4]));
+    std::mt19937 rng(set.seed);
+    fillBackground(img, set, rng);
+    const MatchedRectList rects = chooseLocations(img, mask, set, rng);
+    for (const auto& rect : rects) {
+        plant(img, mask, rect, set, rng);
+    }
+    if (set.noise > 0) {
+        addNoise(img, set.noise, rng);
+    }
+    img.write(args[2]);
+    // The ground truth: the top-left corner of each planted mask.
+    std::ofstream truth(set.truthFile);
+    truth << "# " << args[2] << " (" << img.getWidth() << " x "
+          << img.getHeight() << "), mask: " << args[1] << " ("
+          << mask.getWidth() << " x " << mask.getHeight() << "), planted: "
+          << rects.size() << '\n';
+    for (const auto& rect : rects) {
+        truth << rect.row1 << '\t' << rect.col1 << '\n';
+    }
+    if (int(rects.size()) < set.count) {
+        std::cerr << "Warning: only " << rects.size() << " of " << set.count
+                  << " masks could be planted\n";
+    }
+    return 0;
+}
+
+// End of source code
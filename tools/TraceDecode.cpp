@@ -0,0 +1,208 @@
+//--------------------------------------------------------------------
+//
+// Copyright (C) 2023 raodm@miamiOH.edu
+//
+// Miami University makes no representations or warranties about the
+// suitability of the software, either express or implied, including
+// but not limited to the implied warranties of merchantability,
+// fitness for a particular purpose, or non-infringement.  Miami
+// University shall not be liable for any damages suffered by licensee
+// as a result of using, result of using, modifying or distributing
+// this software or its derivatives.
+//
+// By using or copying this Software, Licensee agrees to abide by the
+// intellectual property laws, and all other applicable laws of the
+// U.S., and the terms of GNU General Public License (version 3).
+//
+// Authors:   Dhananjai M. Rao          raodm@miamioh.edu
+//
+//---------------------------------------------------------------------
+
+// A small program to convert the binary trace files generated by the
+// image search (via --trace=file) into text. Build from the top-level
+// directory with:
+//
+//   g++ -std=c++17 -O2 -I. tools/TraceDecode.cpp PNG.cpp MappedFile.cpp
+//       -o TraceDecode -lpng
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "PNG.h"
+#include "Tracer.h"
+
+// It is ok to use the following namespace delarations in C++ source
+// files only. They must never be used in header files.
+using namespace std;
+
+/**
+ * Helper method to print a pixel in the form (red,green,blue).
+ */
+std::string toString(const Pixel& pix) {
+    return "(" + std::to_string(pix.color.red) + "," +
+        std::to_string(pix.color.green) + "," +
+        std::to_string(pix.color.blue) + ")";
+}
+
+/**
+ * Print the per-pixel comparison for a single window, in the same text
+ * format that was used when debugging with std::cout statements in the
+ * search. The comparison is recomputed from the image and mask recorded
+ * in the trace.
+ *
+ * \param[in] hdr The header of the trace file.
+ *
+ * \param[in] imgFile The path to the image that was searched.
+ *
+ * \param[in] maskFile The path to the mask that was used.
+ *
+ * \param[in] startRow The top row of the window to be printed.
+ *
+ * \param[in] startCol The left column of the window to be printed.
+ */
+void printWindow(const TraceHeader& hdr, const std::string& imgFile,
+                 const std::string& maskFile, const int startRow,
+                 const int startCol, std::ostream& os = std::cout) {
+    PNG img, mask;
+    img.load(imgFile);
+    mask.load(maskFile);
+    const Pixel Black{ .rgba = 0xff'00'00'00U };
+    const std::string Dashes(60, '-');
+    os << "Performing comparison of pixels in " << maskFile << " in "
+       << imgFile << " at row: " << startRow << " and col: " << startCol
+       << ", with tolerance = " << hdr.tolerance << ".\n";
+    // First the pass that computes the background color.
+    int red = 0, green = 0, blue = 0, count = 0;
+    for (int row = 0; (row < mask.getHeight()); row++) {
+        os << "Msk-Row\tMsk-Col\tMain-pixel\tMask-pixel\tBlkCnt\tSumRed\t"
+           << "SumGrn\tSumBlue\n";
+        for (int col = 0; (col < mask.getWidth()); col++) {
+            const Pixel pix = img.getPixel(row + startRow, col + startCol);
+            const Pixel mpix = mask.getPixel(row, col);
+            if (mpix.rgba == Black.rgba) {
+                red   += pix.color.red;
+                green += pix.color.green;
+                blue  += pix.color.blue;
+                count++;
+            }
+            os << row << '\t' << col << '\t' << toString(pix) << '\t'
+               << toString(mpix) << '\t' << count << '\t' << red << '\t'
+               << green << '\t' << blue << '\n';
+        }
+    }
+    Pixel bg{ .rgba = 0xff'00'00'00U };
+    if (count > 0) {
+        bg.color.red   = red / count;
+        bg.color.green = green / count;
+        bg.color.blue  = blue / count;
+    }
+    os << Dashes << '\n' << "Black pixel count = " << count << '\n'
+       << "Background color: " << toString(bg) << '\n';
+    // Next the pass that counts the net matching pixels.
+    const auto inTolerance = [&hdr](int c1, int c2)
+        { return std::abs(c1 - c2) < hdr.tolerance; };
+    int netMatches = 0;
+    for (int row = 0; (row < mask.getHeight()); row++) {
+        os << "Msk-row\tMsk-col\tImg-Pixel\tMask-pixel\tNetMatches\n";
+        for (int col = 0; (col < mask.getWidth()); col++) {
+            const Pixel pix  = img.getPixel(row + startRow, col + startCol);
+            const Pixel mpix = mask.getPixel(row, col);
+            const bool isPixDiff =
+                (inTolerance(pix.color.red,   bg.color.red)   &&
+                 inTolerance(pix.color.green, bg.color.green) &&
+                 inTolerance(pix.color.blue,  bg.color.blue));
+            const int addSub = (mpix.rgba == Black.rgba) ? -1 : 1;
+            netMatches += addSub * (isPixDiff ? -1 : 1);
+            os << row << '\t' << col << '\t' << toString(pix) << '\t'
+               << toString(mpix) << '\t' << netMatches << '\n';
+        }
+    }
+    os << Dashes << '\n' << "Net matching pixels: " << netMatches
+       << ", perctage match: "
+       << (netMatches * 100.0 / (mask.getWidth() * mask.getHeight()))
+       << std::endl;
+}
+
+/**
+ * Print the records in the trace (sorted by row and column) as
+ * tab-separated text.
+ */
+void printRecords(const TraceHeader& hdr, const std::string& imgFile,
+                  const std::string& maskFile,
+                  std::vector<TraceRecord>& records) {
+    std::sort(records.begin(), records.end(),
+              [](const TraceRecord& r1, const TraceRecord& r2) {
+                  return (r1.row == r2.row) ? (r1.col < r2.col) :
+                      (r1.row < r2.row); });
+    std::cout << "# Image: " << imgFile << " (" << hdr.imgWidth << " x "
+              << hdr.imgHeight << "), mask: " << maskFile << " ("
+              << hdr.maskWidth << " x " << hdr.maskHeight << ")\n"
+              << "# Match percent: " << hdr.matchPercent << ", tolerance: "
+              << hdr.tolerance << ", threshold: " << hdr.threshold
+              << ", sample rate: " << hdr.sampleRate << ", records: "
+              << records.size() << '\n'
+              << "Row\tCol\tScore\tBackground\tThread\tCycles\tMatched\n";
+    for (const auto& rec : records) {
+        const Pixel bg{ .rgba = rec.bgRGBA };
+        std::cout << rec.row << '\t' << rec.col << '\t' << rec.score << '\t'
+                  << toString(bg) << '\t' << rec.thread << '\t'
+                  << rec.cycles << '\t' << rec.matched << '\n';
+    }
+}
+
+/**
+ * The main method that reads the trace file and prints it as text.
+ *
+ * \param[in] argv The command-line arguments:
+ *    1. The trace file to be decoded.
+ *    2. Optional: --window=row,col to print the per-pixel comparison of
+ *       the window at the given location, instead of all records.
+ */
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " <TraceFile> "
+                  << "[--window=row,col]\n";
+        return 1;
+    }
+    std::ifstream trace(argv[1], std::ios::binary);
+    TraceHeader hdr;
+    if (!trace.read(reinterpret_cast<char*>(&hdr), sizeof(hdr)) ||
+        (std::strcmp(hdr.magic, "ISTRACE") != 0) ||
+        (hdr.recordSize != sizeof(TraceRecord))) {
+        std::cerr << "Error: " << argv[1] << " is not a valid trace file\n";
+        return 2;
+    }
+    // Read the names of the image files.
+    std::string imgFile(hdr.nameLengths[0], ' ');
+    std::string maskFile(hdr.nameLengths[1], ' ');
+    trace.read(&imgFile[0], imgFile.size());
+    trace.read(&maskFile[0], maskFile.size());
+
+    if ((argc > 2) && (std::strncmp(argv[2], "--window=", 9) == 0)) {
+        if ((hdr.metric != 0) || !hdr.isMask) {
+            std::cerr << "Error: Per-pixel output is only supported for "
+                      << "mask searches using the tolerance metric\n";
+            return 3;
+        }
+        std::istringstream is(argv[2] + 9);
+        int row = 0, col = 0;
+        char comma;
+        is >> row >> comma >> col;
+        printWindow(hdr, imgFile, maskFile, row, col);
+        return 0;
+    }
+    // Read all the records and print them.
+    std::vector<TraceRecord> records;
+    TraceRecord rec;
+    while (trace.read(reinterpret_cast<char*>(&rec), sizeof(rec))) {
+        records.push_back(rec);
+    }
+    printRecords(hdr, imgFile, maskFile, records);
+    return 0;
+}
+
+// End of source code